@@ -3,6 +3,20 @@
 #include <string>
 #include <cstdlib>
 #include <ctime>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <type_traits>
+#include <functional>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <unordered_set>
+#include <unordered_map>
 
 using namespace std;
 
@@ -11,1012 +25,4076 @@ class Blockchain;
 class User;
 class UserList;
 class TransactionPool;
-class BalanceHashTable;
+class BalanceTable;
 
-class BalanceHashTable
+// 64-bit string hash: eight bytes per multiply-rotate round, then the
+// MurmurHash3 finalizer so every input bit reaches the low bits used to
+// pick a slot.
+inline unsigned long long hashString(const string& key)
 {
-private:
-    struct Node
+    const unsigned long long k1 = 0x9E3779B185EBCA87ULL;
+    const unsigned long long k2 = 0xC2B2AE3D27D4EB4FULL;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(key.data());
+    size_t length = key.size();
+    unsigned long long h = 0x27D4EB2F165667C5ULL ^ (length * k1);
+
+    while (length >= 8)
     {
-        string address;
-        float balance;
-        Node* next;
+        unsigned long long word;
+        memcpy(&word, data, 8);
+        h ^= word * k2;
+        h = ((h << 31) | (h >> 33)) * k1;
+        data += 8;
+        length -= 8;
+    }
+    if (length > 0)
+    {
+        unsigned long long word = 0;
+        memcpy(&word, data, length);
+        h ^= word * k2;
+        h = ((h << 31) | (h >> 33)) * k1;
+    }
 
-        Node(string addr, float bal) : address(addr), balance(bal), next(NULL) {}
-    };
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
 
-    int TABLE_SIZE;
-    Node** table;
+typedef unsigned int AccountId;
 
-    int hashFunction(string key)
-    {
-        int hash = 0;
-        for (int i = 0; i < (int)key.length(); i++)
-        {
-            hash = (hash * 31 + key[i]) % TABLE_SIZE;
-        }
-        return hash;
-    }
+const AccountId NO_ACCOUNT = 0xFFFFFFFFu;
+const AccountId SYSTEM_ACCOUNT = 0;
 
-public:
-    BalanceHashTable()
+// Maps every address to a dense 32-bit account ID, handed out in order of
+// first use, so the rest of the ledger can work with integers. Lookups use
+// open addressing with Robin Hood probing. The addresses themselves sit in a
+// dense vector indexed by ID; the probe array only holds 12-byte slots (a
+// hash fragment, the distance from the home slot and the ID), so probing
+// stays within a cache line or two and growing the table never moves a
+// string. An insert takes the slot of any entry that is closer to home than
+// itself, which keeps probe sequences short and lets a lookup stop at the
+// first entry that is closer to home than the key would be. Doubles at 7/8
+// load. "System" is always SYSTEM_ACCOUNT.
+class AddressRegistry
+{
+private:
+    struct Slot
     {
-        TABLE_SIZE = 100;
-        table = new Node*[TABLE_SIZE];
-        for (int i = 0; i < TABLE_SIZE; i++)
-        {
-            table[i] = NULL;
-        }
-    }
+        unsigned int hash;
+        unsigned int distance;      // probe distance + 1; 0 marks an empty slot
+        AccountId account;
+    };
+
+    vector<string> addresses;
+    vector<Slot> slots;
+    size_t mask;
+
+    static const size_t INITIAL_CAPACITY = 16;
 
-    ~BalanceHashTable()
+    AccountId find(const string& address, unsigned long long hash) const
     {
-        for (int i = 0; i < TABLE_SIZE; i++)
+        unsigned int fragment = (unsigned int)(hash >> 32);
+        size_t index = hash & mask;
+        for (unsigned int distance = 1; ; distance++)
         {
-            Node* current = table[i];
-            while (current != NULL)
+            const Slot& slot = slots[index];
+            if (slot.distance < distance)
             {
-                Node* temp = current;
-                current = current->next;
-                delete temp;
+                return NO_ACCOUNT;
+            }
+            if (slot.hash == fragment && addresses[slot.account] == address)
+            {
+                return slot.account;
             }
+            index = (index + 1) & mask;
         }
-        delete[] table;
     }
 
-    void updateBalance(string address, float amount)
+    // The home slot comes from the low hash bits and the stored fragment
+    // from the high ones, so rehashing needs the full hash back; it is
+    // recomputed from the key rather than stored.
+    void place(unsigned long long hash, AccountId account)
     {
-        int index = hashFunction(address);
-        Node* current = table[index];
+        Slot entry;
+        entry.hash = (unsigned int)(hash >> 32);
+        entry.distance = 1;
+        entry.account = account;
 
-        while (current != NULL)
+        size_t index = hash & mask;
+        while (true)
         {
-            if (current->address == address)
+            Slot& slot = slots[index];
+            if (slot.distance == 0)
             {
-                current->balance += amount;
+                slot = entry;
                 return;
             }
-            current = current->next;
+            if (slot.distance < entry.distance)
+            {
+                swap(slot, entry);
+            }
+            index = (index + 1) & mask;
+            entry.distance++;
         }
-
-        Node* newNode = new Node(address, amount);
-        newNode->next = table[index];
-        table[index] = newNode;
     }
 
-    float getBalance(string address)
+    void rehash(size_t capacity)
     {
-        int index = hashFunction(address);
-        Node* current = table[index];
-
-        while (current != NULL)
+        Slot empty = { 0, 0, 0 };
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+        for (size_t i = 0; i < addresses.size(); i++)
         {
-            if (current->address == address)
-            {
-                return current->balance;
-            }
-            current = current->next;
+            place(hashString(addresses[i]), (AccountId)i);
         }
-
-        return 0.0;
     }
 
-    void setBalance(string address, float balance)
+public:
+    AddressRegistry()
     {
-        int index = hashFunction(address);
-        Node* current = table[index];
+        clear();
+    }
 
-        while (current != NULL)
+    // Returns the address's ID, registering it first if it is new.
+    AccountId intern(const string& address)
+    {
+        unsigned long long hash = hashString(address);
+        AccountId account = find(address, hash);
+        if (account != NO_ACCOUNT)
         {
-            if (current->address == address)
-            {
-                current->balance = balance;
-                return;
-            }
-            current = current->next;
+            return account;
         }
 
-        Node* newNode = new Node(address, balance);
-        newNode->next = table[index];
-        table[index] = newNode;
-    }
-
-    void clear()
-    {
-        for (int i = 0; i < TABLE_SIZE; i++)
+        if ((addresses.size() + 1) * 8 > slots.size() * 7)
         {
-            Node* current = table[i];
-            while (current != NULL)
-            {
-                Node* temp = current;
-                current = current->next;
-                delete temp;
-            }
-            table[i] = NULL;
+            rehash(slots.size() * 2);
         }
+        addresses.push_back(address);
+        account = (AccountId)(addresses.size() - 1);
+        place(hash, account);
+        return account;
     }
-};
 
-class Transaction 
-{
-public:
-    string fromAddress;
-    string toAddress;
-    float amount;
-    Transaction* next;
+    // NO_ACCOUNT if the address has never been seen.
+    AccountId find(const string& address) const
+    {
+        return find(address, hashString(address));
+    }
 
-    Transaction(string fromAddress, string toAddress, float amount) 
+    const string& address(AccountId account) const
     {
-        this->fromAddress = fromAddress;
-        this->toAddress = toAddress;
-        this->amount = amount;
-        this->next = NULL;
+        return addresses[account];
     }
 
-    void display()
+    size_t size() const
     {
-        cout << "From: " << fromAddress 
-             << " -> To: " << toAddress 
-             << " | Amount: $" << amount << endl;
+        return addresses.size();
     }
 
-    string convertToString()
+    void clear()
     {
-        return fromAddress + toAddress + to_string(amount);
+        Slot empty = { 0, 0, 0 };
+        addresses.clear();
+        slots.assign(INITIAL_CAPACITY, empty);
+        mask = INITIAL_CAPACITY - 1;
+        intern("System");
     }
 };
 
-class TransactionPool
-{
-public:
-    Transaction* head;
-    int count;
+AddressRegistry addressRegistry;
 
-    TransactionPool() : head(NULL), count(0) {}
+// Amounts are fixed-point minor units (cents), so sums are exact and do not
+// depend on the order they are added in.
+typedef long long Amount;
 
-    ~TransactionPool()
-    {
-        Transaction* current = head;
-        while (current != NULL)
-        {
-            Transaction* temp = current;
-            current = current->next;
-            delete temp;
-        }
-    }
+const Amount UNITS_PER_COIN = 100;
+const Amount MINING_REWARD = 50 * UNITS_PER_COIN;
 
-    void addTransaction(Transaction* tx)
+string formatAmount(Amount amount)
+{
+    unsigned long long magnitude = amount < 0 ? 0ULL - (unsigned long long)amount : (unsigned long long)amount;
+    string cents = to_string(magnitude % UNITS_PER_COIN);
+    if (cents.size() < 2)
     {
-        if (head == NULL)
-        {
-            head = tx;
-        }
-        else
-        {
-            Transaction* temp = head;
-            while (temp->next != NULL)
-            {
-                temp = temp->next;
-            }
-            temp->next = tx;
-        }
-        count++;
+        cents = "0" + cents;
     }
+    return (amount < 0 ? "-" : "") + to_string(magnitude / UNITS_PER_COIN) + "." + cents;
+}
+
+// Accepts "12", "12.5" or "12.34"; anything else, including more than two
+// decimals, is rejected rather than rounded.
+bool parseAmount(const string& text, Amount& amount)
+{
+    size_t i = 0;
+    unsigned long long whole = 0;
+    unsigned long long cents = 0;
 
-    Transaction* getAll()
+    while (i < text.size() && text[i] == ' ')
     {
-        return head;
+        i++;
     }
-
-    void clear()
+    size_t digits = i;
+    while (i < text.size() && text[i] >= '0' && text[i] <= '9')
     {
-        Transaction* current = head;
-        while (current != NULL)
+        whole = whole * 10 + (text[i] - '0');
+        if (whole > (unsigned long long)(LLONG_MAX / UNITS_PER_COIN) - 1)
         {
-            Transaction* temp = current;
-            current = current->next;
-            delete temp;
+            return false;
         }
-        head = NULL;
-        count = 0;
+        i++;
     }
-
-    void display()
+    if (i == digits)
     {
-        if (count == 0)
+        return false;
+    }
+    if (i < text.size() && text[i] == '.')
+    {
+        i++;
+        int decimals = 0;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9' && decimals < 2)
         {
-            cout << "No pending transactions.\n";
-            return;
+            cents = cents * 10 + (text[i] - '0');
+            decimals++;
+            i++;
         }
-
-        cout << "\n========== PENDING TRANSACTIONS ==========\n";
-        cout << "Total: " << count << "\n\n";
-        
-        Transaction* temp = head;
-        int index = 1;
-        while (temp != NULL)
+        if (decimals == 1)
         {
-            cout << index << ". ";
-            temp->display();
-            temp = temp->next;
-            index++;
+            cents *= 10;
         }
-        cout << "==========================================\n\n";
     }
-};
-
-class Block 
-{
-public:
-    string timestamp;
-    Transaction* transactions;
-    int transactionCount;
-    Block* next;
-    string previousHash;
-    string hash;
-    int nonce;
-    string txHash;
-
-    Block(string timestamp, string previousHash) 
-        : next(NULL), nonce(0), transactionCount(0), transactions(NULL)
+    while (i < text.size() && text[i] == ' ')
     {
-        this->timestamp = timestamp;
-        this->previousHash = previousHash;
-        this->hash = calculateHash();
+        i++;
     }
-
-    ~Block()
+    if (i != text.size())
     {
-        Transaction* current = transactions;
-        while (current != NULL)
-        {
-            Transaction* temp = current;
-            current = current->next;
-            delete temp;
-        }
+        return false;
     }
 
-    void addTransaction(Transaction* tx)
+    amount = (Amount)(whole * UNITS_PER_COIN + cents);
+    return true;
+}
+
+// Runs body(begin, end) over [0, count) split into one contiguous chunk per
+// hardware thread, or per thread up to maxThreads if that is nonzero.
+// Ranges too small to be worth a thread run inline.
+void parallelFor(size_t count, size_t minPerThread, const function<void(size_t, size_t)>& body,
+                 size_t maxThreads = 0)
+{
+    size_t threads = thread::hardware_concurrency();
+    if (threads == 0)
     {
-        if (transactions == NULL)
-        {
-            transactions = tx;
-        }
-        else
-        {
-            Transaction* temp = transactions;
-            while (temp->next != NULL)
-            {
-                temp = temp->next;
-            }
-            temp->next = tx;
-        }
-        transactionCount++;
+        threads = 1;
     }
-
-    string calculateTxHash()
+    if (maxThreads != 0 && threads > maxThreads)
     {
-        string data = "";
-        Transaction* temp = transactions;
-        while (temp != NULL)
-        {
-            data += temp->convertToString();
-            temp = temp->next;
-        }
-        return sha256(data);
+        threads = maxThreads;
     }
-
-    void finalizeTransactions()
+    if (threads > count / minPerThread)
     {
-        txHash = calculateTxHash();
+        threads = count / minPerThread;
     }
-
-    string calculateHash()
+    if (threads <= 1)
     {
-        return sha256(timestamp + previousHash + to_string(nonce));
+        body(0, count);
+        return;
     }
 
-    void recalculateHash() 
+    size_t chunk = (count + threads - 1) / threads;
+    vector<thread> workers;
+    for (size_t begin = chunk; begin < count; begin += chunk)
     {
-        hash = calculateHash();
+        workers.push_back(thread(body, begin, min(begin + chunk, count)));
+    }
+    body(0, chunk);
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
     }
+}
 
-    void mineBlock(int difficulty, bool silent = false)
+// Binary Merkle tree over transaction hashes, laid out as in RFC 6962:
+// leaves are SHA-256(0x00 || tx) and inner nodes SHA-256(0x01 || left ||
+// right), so a leaf can never be passed off as an inner node. For n that
+// is not a power of two the left subtree holds the largest power of two
+// below n, which is the same as carrying an odd last node up a level.
+class MerkleTree
+{
+public:
+    // Leaves at least this many per thread before hashing goes parallel.
+    static const size_t PARALLEL_GRAIN = 4096;
+
+    vector<SHA256Digest> leaves;
+
+    void append(const SHA256Digest& leaf)
     {
-        string target = string(difficulty, '0');
-        if (!silent)
-            cout << "Mining block..." << endl;
+        leaves.push_back(leaf);
 
-        while (hash.substr(0, difficulty) != target)
+        // The frontier holds the roots of the perfect subtrees that make up
+        // the tree, largest first; appending merges equal-sized neighbours
+        // like a binary counter, O(log n) hashes at most.
+        frontier.push_back(leaf);
+        for (size_t size = leaves.size(); (size & 1) == 0; size >>= 1)
         {
-            nonce++;
-            hash = calculateHash();
+            SHA256Digest right = frontier.back();
+            frontier.pop_back();
+            frontier.back() = hashNode(frontier.back(), right);
         }
-        
-        if (!silent)
-            cout << "Block mined! Nonce: " << nonce << endl;
     }
-};
 
-class Blockchain 
-{
-public:
-    int difficulty;
-    Block* chain;
-    BalanceHashTable* balanceTable;
+    size_t size() const
+    {
+        return leaves.size();
+    }
 
-    Blockchain() : difficulty(2), chain(NULL)
+    void clear()
     {
-        balanceTable = new BalanceHashTable();
-        chain = createGenesisBlock();
+        leaves.clear();
+        frontier.clear();
     }
 
-    ~Blockchain() 
+    SHA256Digest root() const
     {
-        Block* current = chain;
-        while (current != NULL) 
+        if (frontier.empty())
         {
-            Block* temp = current;
-            current = current->next;
-            delete temp;
+            return sha256_digest(NULL, 0);
         }
-        delete balanceTable;
-    }
 
-    Block* createGenesisBlock() 
-    {
-        Block* genesis = new Block("01/01/2025", "0");
-        Transaction* genesisTx = new Transaction("System", "Network", 0);
-        genesis->addTransaction(genesisTx);
-        genesis->finalizeTransactions();
-        genesis->mineBlock(difficulty, true);
-        return genesis; 
+        SHA256Digest acc = frontier.back();
+        for (size_t i = frontier.size() - 1; i-- > 0; )
+        {
+            acc = hashNode(frontier[i], acc);
+        }
+        return acc;
     }
 
-    void addBlock(string timestamp, Transaction* transactionList, bool silent = false)
+    // Sibling hashes from the leaf up to the root.
+    vector<SHA256Digest> proof(size_t index) const
     {
-        Block* last = getLatestBlock();
-        Block* newBlock = new Block(timestamp, last->hash);
-        
-        Transaction* temp = transactionList;
-        while (temp != NULL)
+        vector<SHA256Digest> path;
+        vector<SHA256Digest> level = leaves;
+        while (level.size() > 1)
         {
-            Transaction* newTx = new Transaction(temp->fromAddress, 
-                                                 temp->toAddress, 
-                                                 temp->amount);
-            newBlock->addTransaction(newTx);
-            
-            if (temp->fromAddress != "System")
+            size_t sibling = index ^ 1;
+            if (sibling < level.size())
             {
-                balanceTable->updateBalance(temp->fromAddress, -temp->amount);
+                path.push_back(level[sibling]);
             }
-            balanceTable->updateBalance(temp->toAddress, temp->amount);
-            
-            temp = temp->next;
+            level = nextLevel(level);
+            index >>= 1;
         }
-        newBlock->finalizeTransactions();
-        
-        newBlock->mineBlock(difficulty, silent);
-        last->next = newBlock;
+        return path;
     }
 
-    bool isChainValid()
+    // RFC 9162 section 2.1.3.2: walks the path with the leaf index and the
+    // last index, which together say whether each sibling sits on the left
+    // or the right and where odd nodes were carried up without a sibling.
+    static bool verify(const SHA256Digest& leaf, size_t index, size_t size,
+                       const vector<SHA256Digest>& proof, const SHA256Digest& root)
     {
-        if (chain == NULL) 
-        {
-            return false;
-        }
-
-        Block* current = chain->next;
-        Block* previous = chain;
-
-        if (previous->hash != previous->calculateHash()) 
+        if (index >= size)
         {
             return false;
         }
 
-        while (current != NULL) 
+        size_t fn = index;
+        size_t sn = size - 1;
+        SHA256Digest acc = leaf;
+        for (size_t i = 0; i < proof.size(); i++)
         {
-            if (current->hash != current->calculateHash()) 
+            if (sn == 0)
             {
                 return false;
             }
 
-            if (current->txHash != current->calculateTxHash())
+            if ((fn & 1) || fn == sn)
             {
-                return false;
+                acc = hashNode(proof[i], acc);
+                while (!(fn & 1) && fn != 0)
+                {
+                    fn >>= 1;
+                    sn >>= 1;
+                }
             }
-
-            if (current->previousHash != previous->hash) 
+            else
             {
-                return false;
+                acc = hashNode(acc, proof[i]);
             }
-
-            previous = current;
-            current = current->next;
+            fn >>= 1;
+            sn >>= 1;
         }
+        return sn == 0 && acc == root;
+    }
 
-        return true;
+    static SHA256Digest hashLeaf(const string& data)
+    {
+        SHA256 sha = prefixState(0x00);
+        sha.update(data);
+        return sha.finalDigest();
     }
 
-    float getBalance(string address)
+    static SHA256Digest hashNode(const SHA256Digest& left, const SHA256Digest& right)
     {
-        return balanceTable->getBalance(address);
+        SHA256 sha = prefixState(0x01);
+        sha.update(left.bytes, sizeof(left.bytes));
+        sha.update(right.bytes, sizeof(right.bytes));
+        return sha.finalDigest();
     }
 
-    Block* getLatestBlock()
+    // Leaf hashes for a whole block, batched through the multi-lane kernels.
+    static vector<SHA256Digest> hashLeaves(const vector<string>& data)
     {
-        Block* temp = chain;
-        while (temp->next != NULL) 
+        size_t count = data.size();
+        vector<SHA256Digest> digests(count);
+        if (count == 0)
         {
-            temp = temp->next;
+            return digests;
         }
-        return temp;
-    }
-
-    void display()
-    {
-        Block* temp = chain;
-        int blockIndex = 0;
 
-        while (temp != NULL)
+        vector<const unsigned char*> pointers(count);
+        vector<size_t> lengths(count);
+        for (size_t i = 0; i < count; i++)
         {
-            cout << "\n==============================================\n";
-            cout << "                BLOCK #" << blockIndex << "\n";
-            cout << "==============================================\n";
-
-            if (temp->previousHash == "0")
-            {
-                cout << " Type: GENESIS BLOCK\n";
-                cout << " Timestamp: " << temp->timestamp << "\n";
-                cout << " Nonce: " << temp->nonce << "\n"; 
-                cout << " Hash: " << temp->hash.substr(0, 32) << "...\n";
-                temp = temp->next; 
-                blockIndex++;
-                continue;
-            }
-
-            cout << " Timestamp: " << temp->timestamp << "\n";
-            cout << " Transactions: " << temp->transactionCount << "\n";
-            cout << " Nonce: " << temp->nonce << "\n"; 
-            cout << " Prev Hash: " << temp->previousHash.substr(0, 32) << "...\n";
-            cout << " Hash: " << temp->hash.substr(0, 32) << "...\n"; 
-
-            cout << "\n-------------- TRANSACTIONS ---------------\n";
-            Transaction* txTemp = temp->transactions;
-            int txIndex = 0;
-            while (txTemp != NULL)
-            {
-                cout << " [" << txIndex << "] ";
-                txTemp->display();
-                txTemp = txTemp->next;
-                txIndex++;
-            }
-
-            temp = temp->next;
-            blockIndex++;
+            pointers[i] = reinterpret_cast<const unsigned char*>(data[i].data());
+            lengths[i] = data[i].size();
         }
-        cout << "==============================================\n\n";
+
+        const SHA256 prefix = prefixState(0x00);
+        parallelFor(count, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+            prefix.finalMany(&pointers[begin], &lengths[begin], end - begin,
+                             reinterpret_cast<unsigned char (*)[32]>(&digests[begin]));
+        });
+        return digests;
     }
 
-    void copyFrom(Blockchain* source)
+    // Full recomputation, one level at a time, for checking a block from
+    // scratch rather than trusting its stored leaves.
+    static SHA256Digest computeRoot(vector<SHA256Digest> level)
     {
-        Block* current = chain;
-        while (current != NULL) 
+        if (level.empty())
         {
-            Block* temp = current;
-            current = current->next;
-            delete temp;
+            return sha256_digest(NULL, 0);
         }
-
-        balanceTable->clear();
-
-        Block* sourceBlock = source->chain;
-        chain = NULL;
-        Block* lastCopied = NULL;
-
-        while (sourceBlock != NULL)
+        while (level.size() > 1)
         {
-            Block* newBlock = new Block(sourceBlock->timestamp, sourceBlock->previousHash);
-            newBlock->nonce = sourceBlock->nonce;
-            
-            Transaction* sourceTx = sourceBlock->transactions;
-            while (sourceTx != NULL)
-            {
-                Transaction* newTx = new Transaction(sourceTx->fromAddress, 
-                                                     sourceTx->toAddress, 
-                                                     sourceTx->amount);
-                newBlock->addTransaction(newTx);
-                
-                if (sourceTx->fromAddress != "System")
-                {
-                    balanceTable->updateBalance(sourceTx->fromAddress, -sourceTx->amount);
-                }
-                balanceTable->updateBalance(sourceTx->toAddress, sourceTx->amount);
-                
-                sourceTx = sourceTx->next;
-            }
-            newBlock->finalizeTransactions();
-            newBlock->hash = sourceBlock->hash;
-            newBlock->txHash = sourceBlock->txHash;
+            level = nextLevel(level);
+        }
+        return level[0];
+    }
 
-            if (chain == NULL)
-            {
-                chain = newBlock;
-                lastCopied = newBlock;
-            }
-            else
-            {
-                lastCopied->next = newBlock;
-                lastCopied = newBlock;
-            }
+private:
+    vector<SHA256Digest> frontier;
 
-            sourceBlock = sourceBlock->next;
-        }
+    static SHA256 prefixState(unsigned char domain)
+    {
+        SHA256 sha;
+        sha.update(&domain, 1);
+        return sha;
     }
 
-    int getBlockCount()
+    // Adjacent digests are already contiguous, so each pair is hashed in
+    // place as one 64-byte tail on top of the 0x01 prefix.
+    static vector<SHA256Digest> nextLevel(const vector<SHA256Digest>& level)
     {
-        int count = 0;
-        Block* temp = chain;
-        while (temp != NULL)
+        size_t pairs = level.size() / 2;
+        vector<SHA256Digest> parents(pairs + (level.size() & 1));
+        vector<const unsigned char*> pointers(pairs);
+        vector<size_t> lengths(pairs, 2 * sizeof(SHA256Digest));
+        for (size_t i = 0; i < pairs; i++)
         {
-            count++;
-            temp = temp->next;
+            pointers[i] = level[2 * i].bytes;
         }
-        return count;
+
+        const SHA256 prefix = prefixState(0x01);
+        if (pairs > 0)
+        {
+            parallelFor(pairs, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+                prefix.finalMany(&pointers[begin], &lengths[begin], end - begin,
+                                 reinterpret_cast<unsigned char (*)[32]>(&parents[begin]));
+            });
+        }
+        if (level.size() & 1)
+        {
+            parents[pairs] = level.back();
+        }
+        return parents;
     }
 };
 
-class User 
+// Every new transaction takes the next value of a randomly seeded counter,
+// so otherwise identical transfers (the same payment made twice, or a
+// miner's repeated rewards) still get distinct transaction IDs.
+unsigned long long nextTransactionNonce()
+{
+    static atomic<unsigned long long> counter(((unsigned long long)random_device()() << 32) ^
+                                              (unsigned long long)time(NULL));
+    return counter++;
+}
+
+class Transaction 
 {
 public:
-    string address;
-    string name;
-    Blockchain* localBlockchain;
-    bool isActive;
-    User* next;
+    AccountId from;
+    AccountId to;
+    Amount amount;
+    Amount fee;         // paid by the sender on top of amount, collected by the miner
+    unsigned long long nonce;
+    Transaction* next;
 
-    User(string address, string name) 
-        : address(address), name(name), localBlockchain(NULL), isActive(true), next(NULL)
+    Transaction(AccountId from, AccountId to, Amount amount, Amount fee = 0)
+        : from(from), to(to), amount(amount), fee(fee), nonce(nextTransactionNonce()), next(NULL) {}
+
+    Transaction(const string& fromAddress, const string& toAddress, Amount amount, Amount fee = 0)
+        : from(addressRegistry.intern(fromAddress)), to(addressRegistry.intern(toAddress)),
+          amount(amount), fee(fee), nonce(nextTransactionNonce()), next(NULL) {}
+
+    // A detached copy of the same transaction, ID included, for putting it
+    // into another list.
+    Transaction* clone() const
     {
-        localBlockchain = new Blockchain();
+        Transaction* copy = new Transaction(from, to, amount, fee);
+        copy->nonce = nonce;
+        return copy;
     }
 
-    ~User()
+    // The canonical transaction ID. It is the transaction's Merkle leaf
+    // hash, so blocks already hold the IDs of their transactions.
+    SHA256Digest id()
     {
-        if (localBlockchain != NULL)
-        {
-            delete localBlockchain;
-        }
+        return MerkleTree::hashLeaf(serialize());
     }
 
-    bool voteOnBlock(Block* proposedBlock, Block* previousBlock)
+    // What the sender's balance goes down by.
+    Amount cost() const
     {
-        if (!isActive || localBlockchain == NULL) 
-        {
-            return false;
-        }
-
-        if (!localBlockchain->isChainValid())
-        {
-            cout << "[" << name << "] Vote: REJECT - My blockchain is invalid\n";
-            return false;
-        }
+        return amount + fee;
+    }
 
-        if (proposedBlock->previousHash != previousBlock->hash) 
-        {
-            cout << "[" << name << "] Vote: REJECT - Previous hash mismatch\n";
-            return false;
-        }
+    const string& fromAddress() const
+    {
+        return addressRegistry.address(from);
+    }
 
-        if (proposedBlock->hash != proposedBlock->calculateHash()) 
-        {
-            cout << "[" << name << "] Vote: REJECT - Invalid hash\n";
-            return false;
-        }
+    const string& toAddress() const
+    {
+        return addressRegistry.address(to);
+    }
 
-        if (proposedBlock->txHash != proposedBlock->calculateTxHash())
+    void display()
+    {
+        cout << "From: " << fromAddress() 
+             << " -> To: " << toAddress() 
+             << " | Amount: $" << formatAmount(amount);
+        if (fee != 0)
         {
-            cout << "[" << name << "] Vote: REJECT - Transaction hash mismatch\n";
-            return false;
+            cout << " | Fee: $" << formatAmount(fee);
         }
+        cout << endl;
+    }
 
-        string hash = proposedBlock->hash;
-        int difficulty = localBlockchain->difficulty;
-        string target = string(difficulty, '0');
-        
-        if (hash.substr(0, difficulty) != target) 
-        {
-            cout << "[" << name << "] Vote: REJECT - Insufficient proof of work\n";
-            return false;
-        }
+    // Commits to the addresses, not the account IDs, which are only a local
+    // numbering. Each address is length-prefixed so that no two different
+    // transactions serialize to the same bytes.
+    string serialize()
+    {
+        string data;
+        appendField(data, fromAddress());
+        appendField(data, toAddress());
+        data.append(reinterpret_cast<const char*>(&amount), sizeof(amount));
+        data.append(reinterpret_cast<const char*>(&fee), sizeof(fee));
+        data.append(reinterpret_cast<const char*>(&nonce), sizeof(nonce));
+        return data;
+    }
 
-        cout << "[" << name << "] Vote: ACCEPT\n";
-        return true;
+private:
+    static void appendField(string& data, const string& field)
+    {
+        unsigned int length = (unsigned int)field.size();
+        data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        data += field;
     }
+};
+
+// The net effect of one block on balances. Block propagation applies the
+// same block to every replica, so when the touched IDs are packed closely
+// the block is reduced once into a dense run of signed deltas starting at
+// `first`, and each replica then adds that run in one branch-free loop the
+// compiler vectorizes. Scattered IDs gain nothing from netting, so such a
+// delta just keeps the transactions and replicas apply them in place.
+// Integer sums commute, so either way the result does not depend on the
+// order of the transactions.
+class BalanceDelta
+{
+public:
+    const Transaction* transactions;
+    bool dense;
+    AccountId first;
+    AccountId highest;
+    vector<Amount> amounts;     // dense form only
 
-    bool voteOnUser(User* newUser)
+    explicit BalanceDelta(const Transaction* head) : transactions(head), dense(false), first(0), highest(0)
     {
-        if (!isActive) 
+        size_t count = 0;
+        AccountId lowest = UINT_MAX;
+        for (const Transaction* tx = head; tx != NULL; tx = tx->next)
         {
-            return false;
+            lowest = min(lowest, min(tx->from, tx->to));
+            highest = max(highest, max(tx->from, tx->to));
+            count++;
+        }
+        if (count == 0 || (size_t)(highest - lowest) >= count * 4)
+        {
+            return;
         }
 
-        cout << "[" << name << "] Vote: ACCEPT new user " << newUser->name << "\n";
-        return true;
+        dense = true;
+        first = lowest;
+        amounts.assign((size_t)(highest - lowest) + 1, 0);
+        for (const Transaction* tx = head; tx != NULL; tx = tx->next)
+        {
+            if (tx->from != SYSTEM_ACCOUNT)
+            {
+                amounts[tx->from - lowest] -= tx->cost();
+            }
+            amounts[tx->to - lowest] += tx->amount;
+        }
     }
+};
 
-    void display()
+// Balances indexed directly by account ID; accounts that have never been
+// touched read as zero.
+class BalanceTable
+{
+private:
+    vector<Amount> balances;
+
+    void reserve(AccountId account)
     {
-        cout << "User: " << name << " | Address: " << address 
-             << " | Status: " << (isActive ? "ACTIVE" : "INACTIVE");
-        
-        if (localBlockchain != NULL)
+        if (account >= balances.size())
         {
-            cout << " | Balance: $" << localBlockchain->getBalance(address);
+            balances.resize(account + 1, 0);
         }
-        cout << endl;
     }
-};
 
-class UserList
-{
 public:
-    User* head;
-    int count;
+    void updateBalance(AccountId account, Amount amount)
+    {
+        reserve(account);
+        balances[account] += amount;
+    }
 
-    UserList() : head(NULL), count(0) {}
+    Amount getBalance(AccountId account) const
+    {
+        return account < balances.size() ? balances[account] : 0;
+    }
 
-    ~UserList()
+    void setBalance(AccountId account, Amount balance)
     {
-        User* current = head;
-        while (current != NULL)
-        {
-            User* temp = current;
-            current = current->next;
-            delete temp;
-        }
+        reserve(account);
+        balances[account] = balance;
     }
 
-    void addUser(User* user)
+    void apply(const BalanceDelta& delta)
     {
-        if (head == NULL)
+        if (!delta.dense)
         {
-            head = user;
+            applyTransactions(delta.transactions);
+            return;
         }
-        else
+        reserve(delta.highest);
+
+        Amount* __restrict balance = &balances[delta.first];
+        const Amount* __restrict amount = &delta.amounts[0];
+        size_t count = delta.amounts.size();
+        for (size_t i = 0; i < count; i++)
         {
-            User* temp = head;
-            while (temp->next != NULL)
-            {
-                temp = temp->next;
-            }
-            temp->next = user;
+            balance[i] += amount[i];
         }
-        count++;
     }
 
-    User* getUserAt(int index)
+    // With balances in a flat array a single table is fastest updated in
+    // place, one transfer at a time; the sums are exact, so the order does
+    // not matter here either.
+    void applyTransactions(const Transaction* head)
     {
-        if (index < 0 || index >= count)
-            return NULL;
-        
-        User* temp = head;
-        for (int i = 0; i < index; i++)
+        for (const Transaction* tx = head; tx != NULL; tx = tx->next)
         {
-            temp = temp->next;
+            reserve(max(tx->from, tx->to));
+            if (tx->from != SYSTEM_ACCOUNT)
+            {
+                balances[tx->from] -= tx->cost();
+            }
+            balances[tx->to] += tx->amount;
         }
-        return temp;
     }
 
-    User* getUserByAddress(string address)
+    // Every nonzero balance, in account order.
+    vector<pair<AccountId, Amount> > nonzeroBalances() const
     {
-        User* temp = head;
-        while (temp != NULL)
+        vector<pair<AccountId, Amount> > result;
+        for (size_t account = 0; account < balances.size(); account++)
         {
-            if (temp->address == address)
-                return temp;
-            temp = temp->next;
+            if (balances[account] != 0)
+            {
+                result.push_back(make_pair((AccountId)account, balances[account]));
+            }
         }
-        return NULL;
+        return result;
     }
 
-    bool isEmpty() { return head == NULL; }
-
-    void display()
+    void clear()
     {
-        cout << "\n========== NETWORK USERS ==========\n";
-        cout << "Total Users: " << count << "\n\n";
-        
-        User* temp = head;
-        int index = 1;
-        while (temp != NULL)
-        {
-            cout << index << ". ";
-            temp->display();
-            temp = temp->next;
-            index++;
-        }
-        cout << "===================================\n\n";
+        balances.clear();
     }
 };
 
-UserList networkUsers;
-TransactionPool txPool;
+const int DEFAULT_POOL_CAPACITY = 100000;
+const int MAX_BLOCK_TRANSACTIONS = 100;     // including the reward transaction
 
-bool consensusOnBlock(Block* proposedBlock, Block* previousBlock, bool silent = false) 
+// Pending transactions. Any number of threads may submit concurrently
+// through a bounded lock-free ring (Dmitry Vyukov's MPMC queue, used here
+// with a single consumer); the miner's thread moves submissions into a
+// binary max-heap ordered by fee, oldest first among equal fees, whenever it
+// reads the pool. The capacity bounds everything pending, submitted or
+// drained, and a full pool refuses new submissions so producers back off
+// instead of growing it.
+class TransactionPool
 {
-    if (networkUsers.isEmpty()) 
+private:
+    struct Cell
     {
-        if (!silent)
-            cout << "[CONSENSUS] No users in network. Block rejected.\n";
-        return false;
-    }
+        atomic<size_t> sequence;
+        Transaction* tx;
+    };
 
-    if (!silent)
+    struct Pending
     {
-        cout << "\n========== CONSENSUS: Block Validation ==========\n";
-        cout << "Broadcasting to " << networkUsers.count << " users...\n\n";
+        Amount fee;
+        unsigned long long arrival;
+        Transaction* tx;
+    };
+
+    struct LowerPriority
+    {
+        bool operator()(const Pending& a, const Pending& b) const
+        {
+            return a.fee < b.fee || (a.fee == b.fee && a.arrival > b.arrival);
+        }
+    };
+
+    Cell* cells;
+    size_t mask;
+    char padding0[64];
+    atomic<size_t> enqueuePosition;
+    char padding1[64];
+    atomic<int> reserved;
+    char padding2[64];
+    size_t dequeuePosition;
+
+    vector<Pending> queue;
+    vector<Pending> selected;
+    unsigned long long arrivals;
+
+    void push(const Pending& pending)
+    {
+        queue.push_back(pending);
+        push_heap(queue.begin(), queue.end(), LowerPriority());
     }
-    int votesFor = 0;
-    int activeUsers = 0;
 
-    User* temp = networkUsers.head;
-    while (temp != NULL)
+    // Single consumer: only the thread that owns the heap calls this.
+    void drain()
     {
-        if (temp->isActive)
+        while (true)
         {
-            activeUsers++;
-            if (temp->voteOnBlock(proposedBlock, previousBlock))
+            Cell* cell = &cells[dequeuePosition & mask];
+            if (cell->sequence.load(memory_order_acquire) != dequeuePosition + 1)
             {
-                votesFor++;
+                return;
             }
+            Pending pending;
+            pending.tx = cell->tx;
+            pending.fee = pending.tx->fee;
+            pending.arrival = arrivals++;
+            cell->sequence.store(dequeuePosition + mask + 1, memory_order_release);
+            dequeuePosition++;
+
+            pending.tx->next = NULL;
+            push(pending);
         }
-        temp = temp->next;
     }
 
-    if (!silent)
-    {
-        cout << "\n--- Voting Results ---\n";
-        cout << "Active Users: " << activeUsers << "\n";
-        cout << "Votes FOR: " << votesFor << "\n";
-        cout << "Votes AGAINST: " << (activeUsers - votesFor) << "\n";
-    }
+public:
+    int capacity;
 
-    bool consensus = (votesFor > activeUsers / 2);
-    
-    if (!silent)
+    TransactionPool(int capacity = DEFAULT_POOL_CAPACITY)
+        : enqueuePosition(0), reserved(0), dequeuePosition(0), arrivals(0), capacity(capacity)
     {
-        if (consensus)
+        size_t size = 1;
+        while (size < (size_t)capacity)
         {
-            cout << "CONSENSUS REACHED: Block ACCEPTED\n";
+            size *= 2;
         }
-        else
+        cells = new Cell[size];
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++)
         {
-            cout << "CONSENSUS FAILED: Block REJECTED\n";
+            cells[i].sequence.store(i, memory_order_relaxed);
         }
-        cout << "================================================\n\n";
     }
-    
-    return consensus;
-}
 
-bool consensusOnNewUser(User* newUser, bool silent = false) 
-{
-    if (networkUsers.isEmpty()) 
+    ~TransactionPool()
     {
-        if (!silent)
-            cout << "[CONSENSUS] First user joining network. Auto-accepted.\n";
-        networkUsers.addUser(newUser);
-        
-        Transaction* bonusTx = new Transaction("System", newUser->address, 100);
-        newUser->localBlockchain->addBlock("Joining Bonus", bonusTx, true);
-        if (!silent)
-            cout << ">>> " << newUser->name << " received $100 joining bonus!\n";
-        
-        return true;
+        clear();
+        delete[] cells;
     }
 
-    if (!silent)
+    // Safe to call from any thread. Returns false, leaving the transaction
+    // with the caller, if the pool is at capacity.
+    bool submit(Transaction* tx)
     {
-        cout << "\n========== CONSENSUS: New User Request ==========\n";
-        cout << "New User: " << newUser->name << "\n";
-        cout << "Address: " << newUser->address << "\n";
-        cout << "Broadcasting to " << networkUsers.count << " users...\n\n";
-    }
+        if (reserved.fetch_add(1, memory_order_relaxed) >= capacity)
+        {
+            reserved.fetch_sub(1, memory_order_relaxed);
+            return false;
+        }
+
+        // The reservation above guarantees a free cell, so this only loops
+        // while other producers win the race for the same position.
+        size_t position = enqueuePosition.load(memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(memory_order_acquire);
+            if (sequence == position)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                position = enqueuePosition.load(memory_order_relaxed);
+            }
+        }
+
+        cell->tx = tx;
+        cell->sequence.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    // Blocks a producer until the miner frees room in the pool.
+    void submitWait(Transaction* tx)
+    {
+        while (!submit(tx))
+        {
+            this_thread::yield();
+        }
+    }
+
+    bool addTransaction(Transaction* tx)
+    {
+        return submit(tx);
+    }
+
+    // Pops the `limit` most valuable transactions, O(k log n), and returns
+    // them best first. They stay out of the pool until the caller either
+    // confirms them (they were mined) or returns them, which restores their
+    // original place in the queue.
+    vector<Transaction*> selectBest(size_t limit)
+    {
+        drain();
+        vector<Transaction*> best;
+        while (best.size() < limit && !queue.empty())
+        {
+            pop_heap(queue.begin(), queue.end(), LowerPriority());
+            selected.push_back(queue.back());
+            best.push_back(queue.back().tx);
+            queue.pop_back();
+        }
+        return best;
+    }
+
+    void confirmSelected()
+    {
+        for (size_t i = 0; i < selected.size(); i++)
+        {
+            delete selected[i].tx;
+        }
+        reserved.fetch_sub((int)selected.size(), memory_order_relaxed);
+        selected.clear();
+    }
+
+    void returnSelected()
+    {
+        for (size_t i = 0; i < selected.size(); i++)
+        {
+            push(selected[i]);
+        }
+        selected.clear();
+    }
+
+    int size()
+    {
+        drain();
+        return (int)queue.size();
+    }
+
+    void clear()
+    {
+        returnSelected();
+        drain();
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            delete queue[i].tx;
+        }
+        reserved.fetch_sub((int)queue.size(), memory_order_relaxed);
+        queue.clear();
+    }
+
+    // Lists the pool in the order it would be mined.
+    void display()
+    {
+        drain();
+        if (queue.empty())
+        {
+            cout << "No pending transactions.\n";
+            return;
+        }
+
+        vector<Pending> ordered = queue;
+        sort(ordered.begin(), ordered.end(), LowerPriority());
+
+        cout << "\n========== PENDING TRANSACTIONS ==========\n";
+        cout << "Total: " << ordered.size() << "\n\n";
+        
+        int index = 1;
+        for (size_t i = ordered.size(); i-- > 0; )
+        {
+            cout << index << ". ";
+            ordered[i].tx->display();
+            index++;
+        }
+        cout << "==========================================\n\n";
+    }
+};
+
+// Insert-only hash map keyed by digest, for the block and transaction
+// indexes. SHA-256 output is already uniformly distributed, so the first
+// eight bytes of the key serve as its hash and plain linear probing keeps
+// chains short. Doubles at 3/4 load.
+template <typename Value>
+class DigestIndex
+{
+private:
+    struct Slot
+    {
+        SHA256Digest key;
+        Value value;
+        bool used;
+    };
+
+    vector<Slot> slots;
+    size_t mask;
+    size_t count;
+
+    static size_t home(const SHA256Digest& key)
+    {
+        unsigned long long hash;
+        memcpy(&hash, key.bytes, sizeof(hash));
+        return (size_t)hash;
+    }
+
+    size_t probe(const SHA256Digest& key) const
+    {
+        size_t index = home(key) & mask;
+        while (slots[index].used && slots[index].key != key)
+        {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+public:
+    DigestIndex()
+    {
+        clear();
+    }
+
+    // Overwrites the value if the key is already present.
+    void insert(const SHA256Digest& key, const Value& value)
+    {
+        if ((count + 1) * 4 > slots.size() * 3)
+        {
+            vector<Slot> old(slots.size() * 2);
+            old.swap(slots);
+            mask = slots.size() - 1;
+            for (size_t i = 0; i < old.size(); i++)
+            {
+                if (old[i].used)
+                {
+                    slots[probe(old[i].key)] = old[i];
+                }
+            }
+        }
+
+        Slot& slot = slots[probe(key)];
+        if (!slot.used)
+        {
+            slot.used = true;
+            slot.key = key;
+            count++;
+        }
+        slot.value = value;
+    }
+
+    bool find(const SHA256Digest& key, Value& value) const
+    {
+        const Slot& slot = slots[probe(key)];
+        if (!slot.used)
+        {
+            return false;
+        }
+        value = slot.value;
+        return true;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    void clear()
+    {
+        slots.assign(16, Slot());
+        mask = slots.size() - 1;
+        count = 0;
+    }
+};
+
+// Where a transaction sits in the chain.
+struct TxLocation
+{
+    unsigned int height;
+    unsigned int position;
+};
+
+// Fixed-layout header that is hashed directly from memory (fields in host
+// byte order). The nonce is the last field, so everything before it can be
+// compressed once into a midstate while mining.
+struct BlockHeader
+{
+    unsigned int version;
+    unsigned int height;
+    unsigned long long timestamp;
+    SHA256Digest previousHash;
+    SHA256Digest txRoot;
+    unsigned long long extraNonce;
+    unsigned long long nonce;
+};
+
+static_assert(is_trivially_copyable<BlockHeader>::value && is_standard_layout<BlockHeader>::value,
+              "BlockHeader must be hashable as raw bytes");
+static_assert(sizeof(BlockHeader) == 96 && offsetof(BlockHeader, nonce) == 88,
+              "BlockHeader must have no padding and end with the nonce");
+
+const unsigned int BLOCK_VERSION = 1;
+const unsigned long long GENESIS_TIME = 1735689600ULL;
+const int GENESIS_DIFFICULTY = 2;
+
+struct MiningSearch
+{
+    mutex lock;
+    atomic<bool> found;
+    unsigned long long bestExtraNonce;
+    unsigned long long bestNonce;
+    SHA256Digest bestDigest;
+    vector<unsigned long long> hashes;
+    vector<double> seconds;
+    chrono::steady_clock::time_point started;
+
+    MiningSearch(int workers)
+        : found(false), bestExtraNonce(0), bestNonce(0), bestDigest(), hashes(workers, 0), seconds(workers, 0),
+          started(chrono::steady_clock::now()) {}
+
+    void report(unsigned long long extra, unsigned long long nonce, const unsigned char* digest)
+    {
+        lock_guard<mutex> guard(lock);
+        if (!found || extra < bestExtraNonce || (extra == bestExtraNonce && nonce < bestNonce))
+        {
+            bestExtraNonce = extra;
+            bestNonce = nonce;
+            bestDigest = SHA256Digest::fromBytes(digest);
+            found = true;
+        }
+    }
+
+    // True once a winner at or below (extra, nonce) is known, i.e. this
+    // worker has nothing lower left to check.
+    bool passed(unsigned long long extra, unsigned long long nonce)
+    {
+        if (!found)
+        {
+            return false;
+        }
+        lock_guard<mutex> guard(lock);
+        return extra > bestExtraNonce || (extra == bestExtraNonce && nonce > bestNonce);
+    }
+};
+
+class Block 
+{
+public:
+    BlockHeader header;
+    string timestamp;
+    Transaction* transactions;
+    Transaction* lastTransaction;
+    vector<Transaction*> transactionsByPosition;
+    int transactionCount;
+    SHA256Digest hash;
+    MerkleTree txTree;     // its leaves are the transaction IDs
+    atomic<int> references; // chains holding the block; starts at one for its creator
+
+    // `timestamp` is the free-form label shown to users; the hashed time is
+    // header.timestamp, in seconds since the epoch.
+    Block(string timestamp, const SHA256Digest& previousHash, unsigned int height,
+          unsigned long long time = (unsigned long long)std::time(NULL))
+        : transactions(NULL), lastTransaction(NULL), transactionCount(0), references(1)
+    {
+        memset(&header, 0, sizeof(header));
+        header.version = BLOCK_VERSION;
+        header.height = height;
+        header.timestamp = time;
+        header.previousHash = previousHash;
+        this->timestamp = timestamp;
+        this->hash = calculateHash();
+    }
+
+    ~Block()
+    {
+        Transaction* current = transactions;
+        while (current != NULL)
+        {
+            Transaction* temp = current;
+            current = current->next;
+            delete temp;
+        }
+    }
+
+    // Once appended, a block is shared by every chain that accepted it and
+    // must not change; release() deletes it with the last reference.
+    Block* retain()
+    {
+        references++;
+        return this;
+    }
+
+    void release()
+    {
+        if (--references == 0)
+        {
+            delete this;
+        }
+    }
+
+    bool isShared() const
+    {
+        return references.load() > 1;
+    }
+
+    // A private copy with the same header and hash, for a chain that is
+    // about to modify a shared block.
+    Block* clone()
+    {
+        Block* copy = new Block(timestamp, header.previousHash, header.height, header.timestamp);
+        for (Transaction* tx = transactions; tx != NULL; tx = tx->next)
+        {
+            copy->addTransaction(tx->clone());
+        }
+        copy->header = header;
+        copy->hash = hash;
+        return copy;
+    }
+
+    void addTransaction(Transaction* tx)
+    {
+        if (transactions == NULL)
+        {
+            transactions = tx;
+        }
+        else
+        {
+            lastTransaction->next = tx;
+        }
+        lastTransaction = tx;
+        transactionsByPosition.push_back(tx);
+        transactionCount++;
+        txTree.append(tx->id());
+    }
+
+    // Rebuilds the Merkle root from the transactions themselves, ignoring
+    // the leaves cached in txTree; this is what validation compares against.
+    SHA256Digest calculateTxHash()
+    {
+        vector<string> data;
+        data.reserve(transactionCount);
+        for (Transaction* temp = transactions; temp != NULL; temp = temp->next)
+        {
+            data.push_back(temp->serialize());
+        }
+        return MerkleTree::computeRoot(MerkleTree::hashLeaves(data));
+    }
+
+    // The header commits to the transactions, so its hash is refreshed too.
+    void finalizeTransactions()
+    {
+        header.txRoot = txTree.root();
+        hash = calculateHash();
+    }
+
+    Transaction* getTransaction(int index)
+    {
+        return index >= 0 && index < transactionCount ? transactionsByPosition[index] : NULL;
+    }
+
+    const SHA256Digest& transactionId(int index) const
+    {
+        return txTree.leaves[index];
+    }
+
+    vector<SHA256Digest> proveTransaction(int index)
+    {
+        return txTree.proof(index);
+    }
+
+    // Checks one transaction against the committed root using only its
+    // proof: O(log n) hashes, independent of the rest of the block.
+    bool verifyTransaction(Transaction* tx, int index, const vector<SHA256Digest>& proof)
+    {
+        return MerkleTree::verify(MerkleTree::hashLeaf(tx->serialize()), index, transactionCount,
+                                  proof, header.txRoot);
+    }
+
+    const unsigned char* headerBytes() const
+    {
+        return reinterpret_cast<const unsigned char*>(&header);
+    }
+
+    SHA256Digest calculateHash()
+    {
+        return sha256_digest(headerBytes(), sizeof(BlockHeader));
+    }
+
+    // Difficulty is still entered as a number of leading zero hex digits;
+    // each digit is four leading zero bits of the binary digest.
+    static int difficultyBits(int difficulty)
+    {
+        return difficulty * 4;
+    }
+
+    static bool meetsDifficulty(const unsigned char* digest, int difficulty)
+    {
+        return sha256_leading_zero_bits(digest) >= difficultyBits(difficulty);
+    }
+
+    void recalculateHash() 
+    {
+        hash = calculateHash();
+    }
+
+    SHA256 prefixState(unsigned long long extra)
+    {
+        BlockHeader prefix = header;
+        prefix.extraNonce = extra;
+        SHA256 midstate;
+        midstate.update(reinterpret_cast<const unsigned char*>(&prefix), offsetof(BlockHeader, nonce));
+        return midstate;
+    }
+
+    // Worker `worker` of `workers` owns every workers-th batch of nonces, so
+    // the stripes interleave and the workers advance through the nonce space
+    // together. When a stripe reaches the end of the 64-bit space the worker
+    // moves to the next extra nonce and starts again from zero.
+    void mineWorker(int worker, int workers, int difficulty, unsigned long long firstNonce,
+                    MiningSearch* search)
+    {
+        size_t lanes = sha256_batch_lanes();
+        unsigned long long stride = (unsigned long long)workers * lanes;
+        unsigned long long extra = header.extraNonce;
+        unsigned long long start = firstNonce + (unsigned long long)worker * lanes;
+        bool wrapped = start < firstNonce;
+        SHA256 midstate = prefixState(extra);
+
+        unsigned long long tails[SHA256_MAX_LANES];
+        const unsigned char* pointers[SHA256_MAX_LANES];
+        size_t lengths[SHA256_MAX_LANES];
+        unsigned char digests[SHA256_MAX_LANES][32];
+        unsigned long long hashes = 0;
+
+        for (size_t i = 0; i < lanes; i++)
+        {
+            pointers[i] = reinterpret_cast<const unsigned char*>(&tails[i]);
+            lengths[i] = sizeof(unsigned long long);
+        }
+
+        while (true)
+        {
+            if (wrapped)
+            {
+                extra++;
+                start = (unsigned long long)worker * lanes;
+                midstate = prefixState(extra);
+                wrapped = false;
+            }
+            if (search->passed(extra, start))
+            {
+                break;
+            }
+
+            unsigned long long remaining = ULLONG_MAX - start;
+            size_t count = remaining < lanes - 1 ? (size_t)remaining + 1 : lanes;
+            for (size_t i = 0; i < count; i++)
+            {
+                tails[i] = start + i;
+            }
+            midstate.finalMany(pointers, lengths, count, digests);
+            hashes += count;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (meetsDifficulty(digests[i], difficulty))
+                {
+                    search->report(extra, start + i, digests[i]);
+                    break;
+                }
+            }
+
+            wrapped = start > ULLONG_MAX - stride;
+            start += stride;
+        }
+
+        search->hashes[worker] = hashes;
+        search->seconds[worker] = chrono::duration<double>(chrono::steady_clock::now() - search->started).count();
+    }
+
+    void mineBlock(int difficulty, bool silent = false, int threads = 1)
+    {
+        if (!silent)
+            cout << "Mining block..." << endl;
+
+        // The header up to the nonce is compressed once into a midstate;
+        // each attempt only hashes the 8 nonce bytes on top of it, from
+        // stack buffers. Workers keep going until they pass the lowest winning
+        // nonce reported so far, so the result is the same nonce a one-by-one
+        // search would find, whatever the thread count.
+        if (!meetsDifficulty(hash.bytes, difficulty))
+        {
+            if (threads < 1)
+            {
+                threads = 1;
+            }
+
+            MiningSearch search(threads);
+            unsigned long long firstNonce = header.nonce + 1;
+            if (firstNonce == 0)
+            {
+                header.extraNonce++;
+            }
+
+            vector<thread> workers;
+            for (int t = 1; t < threads; t++)
+            {
+                workers.push_back(thread(&Block::mineWorker, this, t, threads, difficulty, firstNonce, &search));
+            }
+            mineWorker(0, threads, difficulty, firstNonce, &search);
+            for (size_t t = 0; t < workers.size(); t++)
+            {
+                workers[t].join();
+            }
+
+            header.extraNonce = search.bestExtraNonce;
+            header.nonce = search.bestNonce;
+            hash = search.bestDigest;
+
+            if (!silent)
+            {
+                double totalRate = 0;
+                for (int t = 0; t < threads; t++)
+                {
+                    double rate = search.seconds[t] > 0 ? search.hashes[t] / search.seconds[t] / 1000.0 : 0;
+                    totalRate += rate;
+                    cout << "  Thread " << (t + 1) << ": " << search.hashes[t] << " hashes, "
+                         << rate << " kH/s\n";
+                }
+                cout << "  Total: " << totalRate << " kH/s on " << threads << " thread(s)\n";
+            }
+        }
+        
+        if (!silent)
+        {
+            cout << "Block mined! Nonce: " << header.nonce;
+            if (header.extraNonce != 0)
+            {
+                cout << " (extra nonce " << header.extraNonce << ")";
+            }
+            cout << endl;
+        }
+    }
+};
+
+// Checks on a block that do not depend on who runs them.
+struct BlockVerdict
+{
+    bool hashValid;     // the header hashes to the block's digest
+    bool txRootValid;   // the transactions hash to the header's tx root
+    int workBits;       // leading zero bits of the digest, for each voter's own difficulty
+};
+
+// Verdicts on proposed blocks, shared by every voter in the process, so a
+// block is hashed once per round instead of once per voter. Entries are
+// keyed by the block's digest but only match the very block object that
+// was checked, which the cache keeps alive: proposed blocks never change,
+// while a different block claiming the same digest is checked on its own.
+// Each consensus round ends the cache's hold on its block, so rejected
+// blocks are freed; the cache is also flushed whole if it fills up.
+class VerificationCache
+{
+private:
+    struct Entry
+    {
+        Block* block;
+        BlockVerdict verdict;
+    };
+
+    DigestIndex<Entry> entries;
+    vector<Block*> held;
+    mutex lock;
+
+    void flush()
+    {
+        for (size_t i = 0; i < held.size(); i++)
+        {
+            held[i]->release();
+        }
+        held.clear();
+        entries.clear();
+    }
+
+public:
+    static const size_t CAPACITY = 1024;
+    size_t hits;
+    size_t misses;
+
+    VerificationCache() : hits(0), misses(0) {}
+
+    ~VerificationCache()
+    {
+        flush();
+    }
+
+    // Concurrent voters asking about the same block wait for the first one
+    // to finish hashing it.
+    BlockVerdict verify(Block* block)
+    {
+        lock_guard<mutex> guard(lock);
+        Entry entry;
+        if (entries.find(block->hash, entry) && entry.block == block)
+        {
+            hits++;
+            return entry.verdict;
+        }
+
+        misses++;
+        if (held.size() >= CAPACITY)
+        {
+            flush();
+        }
+        held.push_back(block->retain());
+        entry.block = block;
+        entry.verdict.hashValid = block->hash == block->calculateHash();
+        entry.verdict.txRootValid = block->header.txRoot == block->calculateTxHash();
+        entry.verdict.workBits = block->hash.leadingZeroBits();
+        entries.insert(block->hash, entry);
+        return entry.verdict;
+    }
+
+    // Drops every verdict once the votes that shared them are in.
+    void endRound()
+    {
+        lock_guard<mutex> guard(lock);
+        flush();
+    }
+
+    void clear()
+    {
+        lock_guard<mutex> guard(lock);
+        flush();
+        hits = 0;
+        misses = 0;
+    }
+};
+
+VerificationCache verificationCache;
+
+// Everything derived from a chain's blocks: balances and lookup indexes.
+// Chains holding the same blocks share one state, so a block accepted by
+// all of them is applied and indexed once per distinct state rather than
+// once per chain. A chain that must change a shared state copies it first.
+class ChainState
+{
+public:
+    BalanceTable balances;
+    DigestIndex<unsigned int> blockIndex;   // block hash -> height
+    DigestIndex<TxLocation> txIndex;        // transaction ID -> height and position
+    vector<vector<TxLocation> > history;    // AccountId -> transactions touching it, oldest first
+    atomic<int> references;
+
+    ChainState() : references(1) {}
+
+    ChainState* clone() const
+    {
+        ChainState* copy = new ChainState();
+        copy->balances = balances;
+        copy->blockIndex = blockIndex;
+        copy->txIndex = txIndex;
+        copy->history = history;
+        return copy;
+    }
+
+    ChainState* retain()
+    {
+        references++;
+        return this;
+    }
+
+    void release()
+    {
+        if (--references == 0)
+        {
+            delete this;
+        }
+    }
+
+    bool isShared() const
+    {
+        return references.load() > 1;
+    }
+
+    void clearIndexes()
+    {
+        blockIndex.clear();
+        txIndex.clear();
+        history.clear();
+    }
+
+    void indexBlock(Block* block, unsigned int height)
+    {
+        blockIndex.insert(block->hash, height);
+        for (int position = 0; position < block->transactionCount; position++)
+        {
+            TxLocation location = { height, (unsigned int)position };
+            txIndex.insert(block->transactionId(position), location);
+
+            Transaction* tx = block->getTransaction(position);
+            recordHistory(tx->from, location);
+            if (tx->to != tx->from)
+            {
+                recordHistory(tx->to, location);
+            }
+        }
+    }
+
+    void recordHistory(AccountId account, const TxLocation& location)
+    {
+        if (account >= history.size())
+        {
+            history.resize(account + 1);
+        }
+        history[account].push_back(location);
+    }
+};
+
+class Blockchain 
+{
+public:
+    int difficulty;
+    int miningThreads;
+    int maxBlockTransactions;
+    vector<Block*> chain;       // indexed by height; chain.back() is the tip
+    ChainState* state;          // possibly shared with other chains holding the same blocks
+    size_t verifiedHeight;      // blocks below this height passed validation and are unchanged since
+
+    Blockchain()
+        : difficulty(2), miningThreads(defaultMiningThreads()), maxBlockTransactions(MAX_BLOCK_TRANSACTIONS),
+          verifiedHeight(0)
+    {
+        state = new ChainState();
+        appendBlock(genesisBlock()->retain());
+    }
+
+    ~Blockchain() 
+    {
+        clearBlocks();
+        state->release();
+    }
+
+    void clearBlocks()
+    {
+        for (size_t i = 0; i < chain.size(); i++)
+        {
+            chain[i]->release();
+        }
+        chain.clear();
+        verifiedHeight = 0;
+    }
+
+    // The state, first replaced by a private copy if other chains share it.
+    ChainState* writableState()
+    {
+        if (state->isShared())
+        {
+            ChainState* copy = state->clone();
+            state->release();
+            state = copy;
+        }
+        return state;
+    }
+
+    static int defaultMiningThreads()
+    {
+        unsigned int cores = thread::hardware_concurrency();
+        return cores == 0 ? 1 : (int)cores;
+    }
+
+    // Every node derives the same genesis block, so it is mined once, on one
+    // thread, and shared by every chain; the reference held here keeps it
+    // alive for the whole run.
+    static Block* genesisBlock()
+    {
+        static Block* genesis = createGenesisBlock();
+        return genesis;
+    }
+
+    static Block* createGenesisBlock() 
+    {
+        Block* genesis = new Block("01/01/2025", SHA256Digest(), 0, GENESIS_TIME);
+        Transaction* genesisTx = new Transaction("System", "Network", 0);
+        genesisTx->nonce = 0;   // every node must derive the same genesis block
+        genesis->addTransaction(genesisTx);
+        genesis->finalizeTransactions();
+        genesis->mineBlock(GENESIS_DIFFICULTY, true, 1);
+        return genesis; 
+    }
+
+    // Mines a block of copies of the listed transactions on top of the tip,
+    // without appending it.
+    Block* buildBlock(string timestamp, Transaction* transactionList, bool silent = false)
+    {
+        Block* last = getLatestBlock();
+        Block* newBlock = new Block(timestamp, last->hash, last->header.height + 1);
+        
+        Transaction* temp = transactionList;
+        while (temp != NULL)
+        {
+            Transaction* newTx = temp->clone();
+            newBlock->addTransaction(newTx);
+            temp = temp->next;
+        }
+        newBlock->finalizeTransactions();
+        
+        newBlock->mineBlock(difficulty, silent, miningThreads);
+        return newBlock;
+    }
+
+    void addBlock(string timestamp, Transaction* transactionList, bool silent = false)
+    {
+        appendBlock(buildBlock(timestamp, transactionList, silent));
+    }
+
+    // Replaces the blocks from `height` up with `blocks`, taking over the
+    // caller's references. Extending the tip applies just the new blocks;
+    // replacing any existing block recomputes the state from genesis.
+    void replaceFrom(size_t height, const vector<Block*>& blocks)
+    {
+        bool extending = height == chain.size();
+        for (size_t i = height; i < chain.size(); i++)
+        {
+            chain[i]->release();
+        }
+        chain.resize(height);
+        verifiedHeight = min(verifiedHeight, height);
+
+        if (extending)
+        {
+            for (size_t i = 0; i < blocks.size(); i++)
+            {
+                appendBlock(blocks[i]);
+            }
+            return;
+        }
+
+        state->release();
+        state = new ChainState();
+        chain.insert(chain.end(), blocks.begin(), blocks.end());
+        for (size_t i = 0; i < chain.size(); i++)
+        {
+            state->balances.applyTransactions(chain[i]->transactions);
+        }
+        rebuildIndexes();
+    }
+
+    // Takes over the caller's reference to the block.
+    void appendBlock(Block* block)
+    {
+        ChainState* own = writableState();
+        own->balances.applyTransactions(block->transactions);
+        own->indexBlock(block, (unsigned int)chain.size());
+        chain.push_back(block);
+    }
+
+    // Appends a block whose effects `advanced` already holds; the chain
+    // switches to that state. Used by propagateBlock.
+    void appendAdvanced(Block* block, ChainState* advanced)
+    {
+        chain.push_back(block->retain());
+        if (state != advanced)
+        {
+            advanced->retain();
+            state->release();
+            state = advanced;
+        }
+    }
+
+    // Rebuilds the indexes from the blocks alone, for chains that were
+    // loaded wholesale rather than grown through appendBlock.
+    void rebuildIndexes()
+    {
+        ChainState* own = writableState();
+        own->clearIndexes();
+        for (size_t height = 0; height < chain.size(); height++)
+        {
+            own->indexBlock(chain[height], (unsigned int)height);
+        }
+    }
+
+    // NULL if no block in this chain has that hash.
+    Block* findBlock(const SHA256Digest& hash)
+    {
+        unsigned int height;
+        return state->blockIndex.find(hash, height) ? chain[height] : NULL;
+    }
+
+    bool findTransaction(const SHA256Digest& id, TxLocation& location)
+    {
+        return state->txIndex.find(id, location);
+    }
+
+    size_t getHistoryCount(AccountId account)
+    {
+        return account < state->history.size() ? state->history[account].size() : 0;
+    }
+
+    // Up to `limit` of the account's transactions, newest first, after
+    // skipping the `offset` most recent ones.
+    vector<TxLocation> getHistory(AccountId account, size_t offset, size_t limit)
+    {
+        vector<TxLocation> page;
+        size_t total = getHistoryCount(account);
+        if (offset >= total)
+        {
+            return page;
+        }
+
+        size_t end = min(total, offset + limit);
+        page.reserve(end - offset);
+        for (size_t i = offset; i < end; i++)
+        {
+            page.push_back(state->history[account][total - 1 - i]);
+        }
+        return page;
+    }
+
+    // Pages are numbered from 1.
+    void displayHistory(const string& address, size_t page, size_t pageSize)
+    {
+        AccountId account = addressRegistry.find(address);
+        size_t total = account == NO_ACCOUNT ? 0 : getHistoryCount(account);
+        if (total == 0)
+        {
+            cout << "No confirmed transactions for " << address << ".\n";
+            return;
+        }
+
+        size_t pages = (total + pageSize - 1) / pageSize;
+        if (page < 1 || page > pages)
+        {
+            cout << "Invalid page! " << address << " has " << pages << " page(s).\n";
+            return;
+        }
+
+        cout << "\n--- HISTORY OF " << address << " (page " << page << " of " << pages
+             << ", " << total << " transactions, newest first) ---\n";
+        vector<TxLocation> entries = getHistory(account, (page - 1) * pageSize, pageSize);
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            cout << " Block " << entries[i].height << " [" << entries[i].position << "] ";
+            chain[entries[i].height]->getTransaction(entries[i].position)->display();
+        }
+    }
+
+    // Only the blocks added since the last successful check are validated;
+    // the ones below verifiedHeight are trusted, since every way of changing
+    // an appended block (getWritableBlock) lowers it. `full` revalidates
+    // from genesis. `maxThreads`, if set, caps the validation threads below
+    // miningThreads for callers already running in a pool of their own.
+    bool isChainValid(bool full = false, size_t maxThreads = 0)
+    {
+        if (chain.empty()) 
+        {
+            return false;
+        }
+
+        size_t from = full ? 0 : verifiedHeight;
+        verifiedHeight = findInvalidHeight(from, chain.size(), maxThreads);
+        return verifiedHeight == chain.size();
+    }
+
+    // The lowest height in [from, to) whose block fails validation, or `to`
+    // if all of them pass. Long ranges are split across up to miningThreads
+    // threads, or maxThreads if that is lower. Each thread checks its range
+    // in batches and gives up once a lower failure has been found elsewhere,
+    // so the answer is the same however the work was split.
+    size_t findInvalidHeight(size_t from, size_t to, size_t maxThreads = 0)
+    {
+        if (from >= to)
+        {
+            return to;
+        }
+        size_t threads = (size_t)miningThreads;
+        if (maxThreads != 0 && maxThreads < threads)
+        {
+            threads = maxThreads;
+        }
+
+        atomic<size_t> lowest(to);
+        parallelFor(to - from, VALIDATION_BATCH, [this, from, &lowest](size_t begin, size_t end) {
+            for (size_t batch = from + begin; batch < from + end && batch < lowest.load(); batch += VALIDATION_BATCH)
+            {
+                size_t stop = min(from + end, batch + VALIDATION_BATCH);
+                size_t invalid = checkBlocks(batch, stop);
+                if (invalid < stop)
+                {
+                    size_t current = lowest.load();
+                    while (invalid < current && !lowest.compare_exchange_weak(current, invalid))
+                    {
+                    }
+                    return;
+                }
+            }
+        }, threads);
+        return lowest.load();
+    }
+
+    // Blocks per header batch, and the least a validation thread is given.
+    static const size_t VALIDATION_BATCH = 256;
+
+    // Sequential check of [from, to), returning the first failing height or
+    // `to`. A block is checked against its own header and its link to the
+    // block below, which may lie outside the range.
+    size_t checkBlocks(size_t from, size_t to)
+    {
+        // Every header is independent, so all of them are hashed in one
+        // multi-lane batch before the checks run.
+        size_t n = to - from;
+        vector<const unsigned char*> headers(n);
+        vector<size_t> headerLengths(n, sizeof(BlockHeader));
+        vector<SHA256Digest> headerDigests(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            headers[i] = chain[from + i]->headerBytes();
+        }
+        sha256_many(&headers[0], &headerLengths[0], n,
+                    reinterpret_cast<unsigned char (*)[32]>(&headerDigests[0]));
+
+        for (size_t height = from; height < to; height++) 
+        {
+            Block* block = chain[height];
+            if (block->hash != headerDigests[height - from]) 
+            {
+                return height;
+            }
+
+            if (height == 0)
+            {
+                continue;
+            }
+
+            if (block->header.txRoot != block->calculateTxHash())
+            {
+                return height;
+            }
+
+            if (block->header.previousHash != chain[height - 1]->hash) 
+            {
+                return height;
+            }
+        }
+
+        return to;
+    }
+
+    Amount getBalance(AccountId account)
+    {
+        return state->balances.getBalance(account);
+    }
+
+    Amount getBalance(const string& address)
+    {
+        AccountId account = addressRegistry.find(address);
+        return account == NO_ACCOUNT ? 0 : state->balances.getBalance(account);
+    }
+
+    Block* getLatestBlock()
+    {
+        return chain.back();
+    }
+
+    // NULL if there is no block at that height.
+    Block* getBlock(int height)
+    {
+        return height >= 0 && height < (int)chain.size() ? chain[height] : NULL;
+    }
+
+    // The block at `height`, first replaced by a private copy if other
+    // chains share it, so that changing it only affects this chain. It is
+    // validated again, with everything above it, on the next check.
+    Block* getWritableBlock(int height)
+    {
+        Block* block = getBlock(height);
+        if (block != NULL && (size_t)height < verifiedHeight)
+        {
+            verifiedHeight = height;
+        }
+        if (block != NULL && block->isShared())
+        {
+            chain[height] = block->clone();
+            block->release();
+            block = chain[height];
+        }
+        return block;
+    }
+
+    void display()
+    {
+        for (size_t blockIndex = 0; blockIndex < chain.size(); blockIndex++)
+        {
+            Block* temp = chain[blockIndex];
+            cout << "\n==============================================\n";
+            cout << "                BLOCK #" << blockIndex << "\n";
+            cout << "==============================================\n";
+
+            if (temp->header.previousHash.isZero())
+            {
+                cout << " Type: GENESIS BLOCK\n";
+                cout << " Timestamp: " << temp->timestamp << " (" << temp->header.timestamp << ")\n";
+                cout << " Nonce: " << temp->header.nonce << "\n"; 
+                cout << " Hash: " << temp->hash.toHex().substr(0, 32) << "...\n";
+                continue;
+            }
+
+            cout << " Height: " << temp->header.height << "\n";
+            cout << " Timestamp: " << temp->timestamp << " (" << temp->header.timestamp << ")\n";
+            cout << " Transactions: " << temp->transactionCount << "\n";
+            cout << " Nonce: " << temp->header.nonce << "\n"; 
+            cout << " Prev Hash: " << temp->header.previousHash.toHex().substr(0, 32) << "...\n";
+            cout << " Hash: " << temp->hash.toHex().substr(0, 32) << "...\n"; 
+
+            cout << "\n-------------- TRANSACTIONS ---------------\n";
+            Transaction* txTemp = temp->transactions;
+            int txIndex = 0;
+            while (txTemp != NULL)
+            {
+                cout << " [" << txIndex << "] ";
+                txTemp->display();
+                cout << "      ID: " << temp->transactionId(txIndex).toHex() << "\n";
+                txTemp = txTemp->next;
+                txIndex++;
+            }
+        }
+        cout << "==============================================\n\n";
+    }
+
+    // Shares the source's blocks and state rather than copying them.
+    void copyFrom(Blockchain* source)
+    {
+        clearBlocks();
+        chain.reserve(source->chain.size());
+        for (size_t height = 0; height < source->chain.size(); height++)
+        {
+            chain.push_back(source->chain[height]->retain());
+        }
+
+        source->state->retain();
+        state->release();
+        state = source->state;
+        verifiedHeight = source->verifiedHeight;
+    }
+
+    vector<BlockHeader> getHeaders()
+    {
+        vector<BlockHeader> headers;
+        headers.reserve(chain.size());
+        for (size_t height = 0; height < chain.size(); height++)
+        {
+            headers.push_back(chain[height]->header);
+        }
+        return headers;
+    }
+
+    // A digest of the balances at the tip: SHA-256 over the tip hash, then
+    // each nonzero balance in address order as the address's length (4
+    // bytes), the address, and the amount (8 bytes), little-endian. Account
+    // IDs depend on the order a node registered addresses, so they are left
+    // out and two nodes holding the same state agree on its digest.
+    SHA256Digest stateDigest()
+    {
+        vector<pair<AccountId, Amount> > balances = state->balances.nonzeroBalances();
+        vector<pair<string, Amount> > entries;
+        entries.reserve(balances.size());
+        for (size_t i = 0; i < balances.size(); i++)
+        {
+            entries.push_back(make_pair(addressRegistry.address(balances[i].first), balances[i].second));
+        }
+        sort(entries.begin(), entries.end());
+
+        SHA256 hasher;
+        const SHA256Digest& tip = getLatestBlock()->hash;
+        hasher.update(tip.bytes, sizeof(tip.bytes));
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            unsigned char length[4];
+            unsigned char amount[8];
+            for (int b = 0; b < 4; b++)
+            {
+                length[b] = (unsigned char)(entries[i].first.size() >> (8 * b));
+            }
+            for (int b = 0; b < 8; b++)
+            {
+                amount[b] = (unsigned char)((unsigned long long)entries[i].second >> (8 * b));
+            }
+            hasher.update(length, sizeof(length));
+            hasher.update(entries[i].first);
+            hasher.update(amount, sizeof(amount));
+        }
+        SHA256Digest result;
+        hasher.final(result.bytes);
+        return result;
+    }
+
+    int getBlockCount()
+    {
+        return (int)chain.size();
+    }
+};
+
+// Appends an accepted block to every chain by handle. The block is netted
+// into one delta, and each distinct state among the chains applies and
+// indexes it once; a state is advanced in place when every chain holding
+// it is in `chains`, and copied first otherwise. Per chain, the cost is a
+// pointer append.
+void propagateBlock(Block* block, const vector<Blockchain*>& chains)
+{
+    unordered_map<ChainState*, size_t> groups;     // state -> index into before
+    vector<ChainState*> before;
+    vector<int> holders;
+    vector<size_t> groupOf(chains.size());
+    for (size_t i = 0; i < chains.size(); i++)
+    {
+        pair<unordered_map<ChainState*, size_t>::iterator, bool> found =
+            groups.insert(make_pair(chains[i]->state, before.size()));
+        if (found.second)
+        {
+            before.push_back(chains[i]->state);
+            holders.push_back(0);
+        }
+        groupOf[i] = found.first->second;
+        holders[groupOf[i]]++;
+    }
+
+    BalanceDelta delta(block->transactions);
+    vector<ChainState*> after(before.size());
+    for (size_t s = 0; s < before.size(); s++)
+    {
+        after[s] = holders[s] == before[s]->references.load() ? before[s]->retain() : before[s]->clone();
+        after[s]->balances.apply(delta);
+        after[s]->indexBlock(block, block->header.height);
+    }
+
+    for (size_t i = 0; i < chains.size(); i++)
+    {
+        chains[i]->appendAdvanced(block, after[groupOf[i]]);
+    }
+
+    for (size_t s = 0; s < after.size(); s++)
+    {
+        after[s]->release();
+    }
+}
+
+class User 
+{
+public:
+    string address;
+    AccountId account;
+    string name;
+    Blockchain* localBlockchain;
+    bool isActive;
+    User* next;
+
+    User(string address, string name) 
+        : address(address), account(addressRegistry.intern(address)), name(name), localBlockchain(NULL),
+          isActive(true), next(NULL)
+    {
+        localBlockchain = new Blockchain();
+    }
+
+    ~User()
+    {
+        if (localBlockchain != NULL)
+        {
+            delete localBlockchain;
+        }
+    }
+
+    // Votes run on worker threads, so the verdict is returned in `reason`
+    // for the caller to print rather than written to cout here.
+    // `validationThreads`, if set, caps the threads used to validate the
+    // local chain, for votes cast from a pool of voter threads.
+    bool voteOnBlock(Block* proposedBlock, Block* previousBlock, string& reason, size_t validationThreads = 0)
+    {
+        if (!isActive || localBlockchain == NULL) 
+        {
+            reason = "REJECT - Inactive";
+            return false;
+        }
+
+        if (!localBlockchain->isChainValid(false, validationThreads))
+        {
+            reason = "REJECT - My blockchain is invalid";
+            return false;
+        }
+
+        if (proposedBlock->header.previousHash != previousBlock->hash) 
+        {
+            reason = "REJECT - Previous hash mismatch";
+            return false;
+        }
+
+        BlockVerdict verdict = verificationCache.verify(proposedBlock);
+        if (!verdict.hashValid) 
+        {
+            reason = "REJECT - Invalid hash";
+            return false;
+        }
+
+        if (!verdict.txRootValid)
+        {
+            reason = "REJECT - Transaction hash mismatch";
+            return false;
+        }
+
+        int difficulty = localBlockchain->difficulty;
+        
+        if (verdict.workBits < Block::difficultyBits(difficulty)) 
+        {
+            reason = "REJECT - Insufficient proof of work";
+            return false;
+        }
+
+        reason = "ACCEPT";
+        return true;
+    }
+
+    bool voteOnUsers(const vector<User*>& newUsers)
+    {
+        if (!isActive) 
+        {
+            return false;
+        }
+
+        if (newUsers.size() == 1)
+            cout << "[" << name << "] Vote: ACCEPT new user " << newUsers[0]->name << "\n";
+        else
+            cout << "[" << name << "] Vote: ACCEPT " << newUsers.size() << " new users\n";
+        return true;
+    }
+
+    void display()
+    {
+        cout << "User: " << name << " | Address: " << address 
+             << " | Status: " << (isActive ? "ACTIVE" : "INACTIVE");
+        
+        if (localBlockchain != NULL)
+        {
+            cout << " | Balance: $" << formatAmount(localBlockchain->getBalance(account));
+        }
+        cout << endl;
+    }
+};
+
+class UserList
+{
+public:
+    User* head;
+    int count;
+    vector<User*> members;      // the same users by position, for O(1) access and sampling
+
+    UserList() : head(NULL), count(0) {}
+
+    ~UserList()
+    {
+        User* current = head;
+        while (current != NULL)
+        {
+            User* temp = current;
+            current = current->next;
+            delete temp;
+        }
+    }
+
+    void addUser(User* user)
+    {
+        if (head == NULL)
+        {
+            head = user;
+        }
+        else
+        {
+            members.back()->next = user;
+        }
+        members.push_back(user);
+        count++;
+    }
+
+    User* getUserAt(int index)
+    {
+        if (index < 0 || index >= count)
+            return NULL;
+        
+        return members[index];
+    }
+
+    // `size` distinct users drawn with Floyd's algorithm from a generator
+    // seeded by `seed`, so every node derives the same committee. Costs
+    // O(size log size) whatever the number of users.
+    vector<User*> sampleCommittee(const SHA256Digest& seed, int size)
+    {
+        unsigned long long seedValue;
+        memcpy(&seedValue, seed.bytes, sizeof(seedValue));
+        mt19937_64 rng(seedValue);
+
+        // j itself is never already chosen, as every earlier pick is below it.
+        unordered_set<int> chosen;
+        chosen.reserve(size);
+        vector<int> picked;
+        picked.reserve(size);
+        for (int j = count - size; j < count; j++)
+        {
+            int candidate = (int)(rng() % (unsigned long long)(j + 1));
+            if (!chosen.insert(candidate).second)
+            {
+                candidate = j;
+                chosen.insert(candidate);
+            }
+            picked.push_back(candidate);
+        }
+        sort(picked.begin(), picked.end());
+
+        vector<User*> committee;
+        committee.reserve(size);
+        for (size_t i = 0; i < picked.size(); i++)
+        {
+            committee.push_back(members[picked[i]]);
+        }
+        return committee;
+    }
+
+    User* getUserByAccount(AccountId account)
+    {
+        User* temp = head;
+        while (temp != NULL)
+        {
+            if (temp->account == account)
+                return temp;
+            temp = temp->next;
+        }
+        return NULL;
+    }
+
+    User* getUserByAddress(const string& address)
+    {
+        AccountId account = addressRegistry.find(address);
+        return account == NO_ACCOUNT ? NULL : getUserByAccount(account);
+    }
+
+    bool isEmpty() { return head == NULL; }
+
+    vector<Blockchain*> chains()
+    {
+        vector<Blockchain*> result;
+        for (User* temp = head; temp != NULL; temp = temp->next)
+        {
+            result.push_back(temp->localBlockchain);
+        }
+        return result;
+    }
+
+    void display()
+    {
+        cout << "\n========== NETWORK USERS ==========\n";
+        cout << "Total Users: " << count << "\n\n";
+        
+        User* temp = head;
+        int index = 1;
+        while (temp != NULL)
+        {
+            cout << index << ". ";
+            temp->display();
+            temp = temp->next;
+            index++;
+        }
+        cout << "===================================\n\n";
+    }
+};
+
+UserList networkUsers;
+TransactionPool txPool;
+
+// One validator's part in a consensus round.
+struct VoteRecord
+{
+    int verdict;        // 1 for, -1 against, 0 not polled because the outcome was settled
+    string reason;
+    double seconds;     // time the vote took
+};
+
+// Polls the voters on a pool of worker threads, each taking the next voter
+// not yet polled, and stops handing out votes once it is certain whether
+// `required` votes for will be reached. Returns the number of votes for;
+// records[i] holds voter i's vote.
+int collectVotes(const vector<User*>& voters, Block* proposedBlock, Block* previousBlock,
+                 vector<VoteRecord>& records, int required, size_t maxThreads = 0)
+{
+    size_t n = voters.size();
+    int blocking = (int)n - required + 1;   // votes against that make `required` impossible
+    records.assign(n, VoteRecord());
+    for (size_t i = 0; i < n; i++)
+    {
+        records[i].verdict = 0;
+        records[i].seconds = 0;
+    }
+
+    size_t cores = thread::hardware_concurrency();
+    if (cores == 0)
+    {
+        cores = 1;
+    }
+    size_t threads = cores;
+    if (maxThreads != 0 && threads > maxThreads)
+    {
+        threads = maxThreads;
+    }
+    if (threads > n)
+    {
+        threads = n;
+    }
+    // Each voter validates its chain on its share of the cores, so the
+    // pool does not start a validation pool per voter on top of itself.
+    size_t validationThreads = max((size_t)1, cores / max(threads, (size_t)1));
+
+    atomic<size_t> nextVoter(0);
+    atomic<int> votesFor(0);
+    atomic<int> votesAgainst(0);
+    function<void()> worker = [&]() {
+        while (votesFor.load() < required && votesAgainst.load() < blocking)
+        {
+            size_t i = nextVoter++;
+            if (i >= n)
+            {
+                return;
+            }
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            bool accept = voters[i]->voteOnBlock(proposedBlock, previousBlock, records[i].reason,
+                                                  validationThreads);
+            records[i].seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            records[i].verdict = accept ? 1 : -1;
+            (accept ? votesFor : votesAgainst)++;
+        }
+    };
+
+    vector<thread> pool;
+    for (size_t t = 1; t < threads; t++)
+    {
+        pool.push_back(thread(worker));
+    }
+    worker();
+    for (size_t t = 0; t < pool.size(); t++)
+    {
+        pool[t].join();
+    }
+    return votesFor.load();
+}
+
+// The p-th percentile (0-100) of the vote times of polled voters.
+double voteLatencyPercentile(const vector<VoteRecord>& records, double p)
+{
+    vector<double> times;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i].verdict != 0)
+        {
+            times.push_back(records[i].seconds);
+        }
+    }
+    if (times.empty())
+    {
+        return 0;
+    }
+    sort(times.begin(), times.end());
+    size_t rank = (size_t)(p / 100.0 * (times.size() - 1) + 0.5);
+    return times[rank];
+}
+
+// Committee size for consensus rounds; 0 polls every active user.
+int consensusCommitteeSize = 0;
+
+bool committeeConsensus(const UserList& users)
+{
+    return consensusCommitteeSize > 0 && consensusCommitteeSize < users.count;
+}
+
+// The users who vote in a round, and in `required` the votes for it needs.
+// With a committee size set below the network size, a committee is drawn
+// from `seed` and must approve by a two-thirds supermajority; inactive
+// members count as votes against. Otherwise every active user votes and a
+// simple majority decides.
+vector<User*> chooseVoters(UserList& users, const SHA256Digest& seed, int& required)
+{
+    vector<User*> voters;
+    if (committeeConsensus(users))
+    {
+        voters = users.sampleCommittee(seed, consensusCommitteeSize);
+        required = (int)voters.size() * 2 / 3 + 1;
+        return voters;
+    }
+
+    for (User* temp = users.head; temp != NULL; temp = temp->next)
+    {
+        if (temp->isActive)
+        {
+            voters.push_back(temp);
+        }
+    }
+    required = (int)voters.size() / 2 + 1;
+    return voters;
+}
+
+// How sure a committee's decision is about the whole network. By
+// Hoeffding's inequality, which also holds when sampling without
+// replacement, a committee of k misjudges the network's approval share by
+// t or more with probability at most exp(-2 k t^2). An acceptance is
+// measured against the network majority, a rejection against the
+// supermajority it failed to reach.
+double committeeConfidence(int votesFor, int committee, bool accepted)
+{
+    if (committee == 0)
+    {
+        return 0;
+    }
+    double share = (double)votesFor / committee;
+    double margin = accepted ? share - 0.5 : 2.0 / 3.0 - share;
+    return margin <= 0 ? 0 : 1 - exp(-2.0 * committee * margin * margin);
+}
+
+void reportCommittee(int committee, int networkSize, int required, int votesFor, bool accepted)
+{
+    cout << "Committee: " << committee << " of " << networkSize
+         << " users, seeded by the chain tip hash; " << required << " votes needed\n";
+    cout << "Confidence that the network " << (accepted ? "majority approves" : "would not reach a supermajority")
+         << ": " << committeeConfidence(votesFor, committee, accepted) * 100 << "%\n";
+}
+
+bool consensusOnBlock(Block* proposedBlock, Block* previousBlock, bool silent = false) 
+{
+    if (networkUsers.isEmpty()) 
+    {
+        if (!silent)
+            cout << "[CONSENSUS] No users in network. Block rejected.\n";
+        return false;
+    }
+
+    bool committee = committeeConsensus(networkUsers);
+    if (!silent)
+    {
+        cout << "\n========== CONSENSUS: Block Validation ==========\n";
+        if (committee)
+            cout << "Broadcasting to a committee of " << consensusCommitteeSize << " users...\n\n";
+        else
+            cout << "Broadcasting to " << networkUsers.count << " users...\n\n";
+    }
+    int required;
+    vector<User*> voters = chooseVoters(networkUsers, previousBlock->hash, required);
+    int activeUsers = (int)voters.size();
+
+    vector<VoteRecord> records;
+    int votesFor = collectVotes(voters, proposedBlock, previousBlock, records, required);
+    verificationCache.endRound();
+    int votesAgainst = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i].verdict != 0)
+        {
+            cout << "[" << voters[i]->name << "] Vote: " << records[i].reason << "\n";
+        }
+        if (records[i].verdict < 0)
+        {
+            votesAgainst++;
+        }
+    }
+
+    if (!silent)
+    {
+        cout << "\n--- Voting Results ---\n";
+        cout << (committee ? "Committee Members: " : "Active Users: ") << activeUsers << "\n";
+        cout << "Votes FOR: " << votesFor << "\n";
+        cout << "Votes AGAINST: " << votesAgainst << "\n";
+        if (votesFor + votesAgainst < activeUsers)
+        {
+            cout << "Not polled (outcome already settled): " << (activeUsers - votesFor - votesAgainst) << "\n";
+        }
+        cout << "Vote latency (ms): p50 " << voteLatencyPercentile(records, 50) * 1e3
+             << ", p90 " << voteLatencyPercentile(records, 90) * 1e3
+             << ", p99 " << voteLatencyPercentile(records, 99) * 1e3
+             << ", max " << voteLatencyPercentile(records, 100) * 1e3 << "\n";
+    }
+
+    bool consensus = (votesFor >= required);
+    
+    if (!silent)
+    {
+        if (committee)
+        {
+            reportCommittee(activeUsers, networkUsers.count, required, votesFor, consensus);
+        }
+        if (consensus)
+        {
+            cout << "CONSENSUS REACHED: Block ACCEPTED\n";
+        }
+        else
+        {
+            cout << "CONSENSUS FAILED: Block REJECTED\n";
+        }
+        cout << "================================================\n\n";
+    }
+    
+    return consensus;
+}
+
+// Checks that the headers form a chain from this node's genesis block, each
+// carrying at least minimal proof of work and linking to the hash of the
+// one below. The headers are hashed in one multi-lane batch into `hashes`.
+bool verifyHeaderChain(const vector<BlockHeader>& headers, vector<SHA256Digest>& hashes)
+{
+    size_t n = headers.size();
+    hashes.assign(n, SHA256Digest());
+    if (n == 0)
+    {
+        return false;
+    }
+
+    vector<const unsigned char*> messages(n);
+    vector<size_t> lengths(n, sizeof(BlockHeader));
+    for (size_t i = 0; i < n; i++)
+    {
+        messages[i] = reinterpret_cast<const unsigned char*>(&headers[i]);
+    }
+    sha256_many(&messages[0], &lengths[0], n, reinterpret_cast<unsigned char (*)[32]>(&hashes[0]));
+
+    if (hashes[0] != Blockchain::genesisBlock()->hash)
+    {
+        return false;
+    }
+    for (size_t height = 0; height < n; height++)
+    {
+        if (headers[height].height != height || hashes[height].leadingZeroBits() < Block::difficultyBits(1))
+        {
+            return false;
+        }
+        if (height > 0 && headers[height].previousHash != hashes[height - 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const size_t SYNC_CHUNK_BLOCKS = 128;
+
+struct SyncReport
+{
+    size_t fromHeight;      // first height downloaded
+    size_t blocks;
+    size_t chunks;
+    size_t peers;
+    int retries;            // chunk fetches repeated after a peer returned bad data
+    vector<size_t> badPeers;
+    double seconds;
+};
+
+// The in-process transport: the blocks a peer serves for heights [from, to),
+// retained for the caller. A peer with a shorter chain serves fewer.
+vector<Block*> fetchBlocks(Blockchain* peer, size_t from, size_t to)
+{
+    vector<Block*> blocks;
+    for (size_t height = from; height < to && height < peer->chain.size(); height++)
+    {
+        blocks.push_back(peer->chain[height]->retain());
+    }
+    return blocks;
+}
+
+// Whether `blocks` are exactly the blocks at heights [from, from + count)
+// of the verified header chain: each must carry the header that hashes to
+// the verified hash, and transactions matching that header's root.
+bool checkChunk(const vector<Block*>& blocks, size_t from, size_t count, const vector<SHA256Digest>& hashes)
+{
+    if (blocks.size() != count)
+    {
+        return false;
+    }
+
+    vector<const unsigned char*> headers(count);
+    vector<size_t> headerLengths(count, sizeof(BlockHeader));
+    vector<SHA256Digest> headerDigests(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        headers[i] = blocks[i]->headerBytes();
+    }
+    sha256_many(&headers[0], &headerLengths[0], count,
+                reinterpret_cast<unsigned char (*)[32]>(&headerDigests[0]));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (headerDigests[i] != hashes[from + i] || blocks[i]->hash != hashes[from + i])
+        {
+            return false;
+        }
+        if (from + i > 0 && blocks[i]->header.txRoot != blocks[i]->calculateTxHash())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Brings `target` up to the chain most peers hold, downloading only the
+// heights it is missing or holds wrong. The headers come first, from a
+// peer at the most common tip, and are verified as a chain. The missing
+// range is then split into chunks of SYNC_CHUNK_BLOCKS that a pool of
+// workers fetches, chunk c first from peer c modulo the peer count, and
+// checks against the headers as they arrive. A peer whose chain is too
+// short for a chunk is passed over for it; one that serves a bad chunk is
+// dropped, and either way the chunk is fetched from the next peer. The
+// chunks are spliced onto the chain in height order once all have
+// arrived. Returns false, leaving `target` untouched, if no peer could
+// serve some chunk.
+bool syncChain(Blockchain* target, const vector<Blockchain*>& peers, SyncReport& report, size_t maxThreads = 0)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    auto elapsed = [&]() { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+    report.fromHeight = 0;
+    report.blocks = 0;
+    report.chunks = 0;
+    report.peers = peers.size();
+    report.retries = 0;
+    report.badPeers.clear();
+    report.seconds = 0;
+    if (peers.empty())
+    {
+        return false;
+    }
+
+    // The most common tip among the peers, and verified headers leading to it.
+    size_t best = 0;
+    int bestCount = 0;
+    for (size_t i = 0; i < peers.size(); i++)
+    {
+        int count = 0;
+        for (size_t j = 0; j < peers.size(); j++)
+        {
+            if (peers[j]->getLatestBlock()->hash == peers[i]->getLatestBlock()->hash)
+            {
+                count++;
+            }
+        }
+        if (count > bestCount)
+        {
+            best = i;
+            bestCount = count;
+        }
+    }
+    vector<SHA256Digest> hashes;
+    bool haveHeaders = false;
+    for (size_t i = 0; i < peers.size() && !haveHeaders; i++)
+    {
+        if (peers[i]->getLatestBlock()->hash == peers[best]->getLatestBlock()->hash)
+        {
+            haveHeaders = verifyHeaderChain(peers[i]->getHeaders(), hashes);
+        }
+    }
+    if (!haveHeaders)
+    {
+        return false;
+    }
+
+    // Everything from the first block that is invalid or off the header
+    // chain is downloaded again.
+    target->isChainValid();
+    size_t total = hashes.size();
+    size_t from = min(target->verifiedHeight, total);
+    for (size_t height = 0; height < from; height++)
+    {
+        if (target->chain[height]->hash != hashes[height])
+        {
+            from = height;
+            break;
+        }
+    }
+    report.fromHeight = from;
+    if (from == total && target->chain.size() == total)
+    {
+        report.seconds = elapsed();
+        return true;
+    }
+
+    size_t chunks = (total - from + SYNC_CHUNK_BLOCKS - 1) / SYNC_CHUNK_BLOCKS;
+    vector<vector<Block*> > fetched(chunks);
+    vector<bool> bad(peers.size(), false);
+    mutex badLock;
+    atomic<size_t> nextChunk(0);
+    atomic<bool> failed(false);
+    atomic<int> retries(0);
+    function<void()> worker = [&]() {
+        while (!failed.load())
+        {
+            size_t c = nextChunk++;
+            if (c >= chunks)
+            {
+                return;
+            }
+            size_t begin = from + c * SYNC_CHUNK_BLOCKS;
+            size_t count = min(SYNC_CHUNK_BLOCKS, total - begin);
+            bool served = false;
+            for (size_t attempt = 0; attempt < peers.size() && !served; attempt++)
+            {
+                size_t peer = (c + attempt) % peers.size();
+                {
+                    lock_guard<mutex> guard(badLock);
+                    if (bad[peer])
+                    {
+                        continue;
+                    }
+                }
+                vector<Block*> blocks = fetchBlocks(peers[peer], begin, begin + count);
+                bool complete = blocks.size() == count;
+                if (complete && checkChunk(blocks, begin, count, hashes))
+                {
+                    fetched[c].swap(blocks);
+                    served = true;
+                    continue;
+                }
+                for (size_t i = 0; i < blocks.size(); i++)
+                {
+                    blocks[i]->release();
+                }
+                if (!complete)
+                {
+                    // Only behind: it may still serve lower chunks.
+                    continue;
+                }
+                lock_guard<mutex> guard(badLock);
+                bad[peer] = true;
+                retries++;
+            }
+            if (!served)
+            {
+                failed = true;
+            }
+        }
+    };
+
+    size_t threads = thread::hardware_concurrency();
+    if (maxThreads != 0 && threads > maxThreads)
+    {
+        threads = maxThreads;
+    }
+    threads = min(threads, min(peers.size(), chunks));
+    vector<thread> pool;
+    for (size_t t = 1; t < threads; t++)
+    {
+        pool.push_back(thread(worker));
+    }
+    worker();
+    for (size_t t = 0; t < pool.size(); t++)
+    {
+        pool[t].join();
+    }
+
+    for (size_t i = 0; i < peers.size(); i++)
+    {
+        if (bad[i])
+        {
+            report.badPeers.push_back(i);
+        }
+    }
+    report.retries = retries.load();
+    report.chunks = chunks;
+
+    vector<Block*> blocks;
+    blocks.reserve(total - from);
+    for (size_t c = 0; c < chunks; c++)
+    {
+        blocks.insert(blocks.end(), fetched[c].begin(), fetched[c].end());
+    }
+    if (failed.load())
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            blocks[i]->release();
+        }
+        report.seconds = elapsed();
+        return false;
+    }
+
+    // The kept blocks were valid and every new one matches the verified
+    // headers, which link it to the block below.
+    target->replaceFrom(from, blocks);
+    target->verifiedHeight = target->chain.size();
+    report.blocks = blocks.size();
+    report.seconds = elapsed();
+    return true;
+}
+
+const int JOIN_PEERS = 5;
+
+// Checks the chain a joining user is about to share before it does: the
+// headers must link from this node's genesis to the source's tip, and a
+// majority of up to JOIN_PEERS users sampled from the network must report
+// the source's tip and state digest. The digest is computed once per
+// distinct state, as peers holding the same blocks share one.
+bool verifyJoinSource(Blockchain* source, UserList& network, bool silent)
+{
+    vector<SHA256Digest> hashes;
+    const SHA256Digest& tip = source->getLatestBlock()->hash;
+    if (!verifyHeaderChain(source->getHeaders(), hashes) || hashes.back() != tip)
+    {
+        if (!silent)
+            cout << "Join check: " << network.head->name << "'s header chain failed verification.\n";
+        return false;
+    }
+
+    unordered_map<ChainState*, SHA256Digest> digests;
+    SHA256Digest expected = source->stateDigest();
+    digests[source->state] = expected;
+    vector<User*> sampled = network.sampleCommittee(tip, min(JOIN_PEERS, network.count));
+    int agreeing = 0;
+    for (size_t i = 0; i < sampled.size(); i++)
+    {
+        Blockchain* peer = sampled[i]->localBlockchain;
+        if (!sampled[i]->isActive || peer->getLatestBlock()->hash != tip)
+        {
+            continue;
+        }
+        unordered_map<ChainState*, SHA256Digest>::iterator known = digests.find(peer->state);
+        if (known == digests.end())
+        {
+            known = digests.insert(make_pair(peer->state, peer->stateDigest())).first;
+        }
+        if (known->second == expected)
+        {
+            agreeing++;
+        }
+    }
+
+    if (!silent)
+    {
+        cout << "Join check: " << hashes.size() << " headers verified, state digest "
+             << expected.toHex().substr(0, 16) << "... agreed by " << agreeing << "/" << sampled.size()
+             << " sampled peers\n";
+    }
+    return agreeing * 2 > (int)sampled.size();
+}
+
+// Admits a batch of users after a single vote round on the whole batch.
+// Their joining bonuses go into one block, mined once and propagated to
+// every chain, and the new users share the network's existing blocks, once
+// verifyJoinSource has checked them, so admitting N users adds one block
+// rather than N to each chain. An empty network admits the batch without a
+// vote, its first user founding it.
+bool consensusOnNewUsers(const vector<User*>& newUsers, bool silent = false, UserList& network = networkUsers)
+{
+    if (newUsers.empty())
+    {
+        return true;
+    }
+
+    bool founding = network.isEmpty();
+    if (founding) 
+    {
+        if (!silent)
+            cout << "[CONSENSUS] First user joining network. Auto-accepted.\n";
+    }
+    else
+    {
+        bool committee = committeeConsensus(network);
+        if (!silent)
+        {
+            cout << "\n========== CONSENSUS: New User Request ==========\n";
+            if (newUsers.size() == 1)
+            {
+                cout << "New User: " << newUsers[0]->name << "\n";
+                cout << "Address: " << newUsers[0]->address << "\n";
+            }
+            else
+            {
+                cout << "New Users: " << newUsers.size() << "\n";
+            }
+            if (committee)
+                cout << "Broadcasting to a committee of " << consensusCommitteeSize << " users...\n\n";
+            else
+                cout << "Broadcasting to " << network.count << " users...\n\n";
+        }
+
+        int required;
+        vector<User*> voters = chooseVoters(network, network.head->localBlockchain->getLatestBlock()->hash,
+                                            required);
+        int activeUsers = (int)voters.size();
+        int votesFor = 0;
+        for (size_t i = 0; i < voters.size(); i++)
+        {
+            if (voters[i]->voteOnUsers(newUsers)) 
+            {
+                votesFor++;
+            }
+        }
+
+        bool consensus = (votesFor >= required);
+
+        if (!silent)
+        {
+            cout << "\n--- Voting Results ---\n";
+            cout << (committee ? "Committee Members: " : "Active Users: ") << activeUsers << "\n";
+            cout << "Votes FOR: " << votesFor << "\n";
+            cout << "Votes AGAINST: " << (activeUsers - votesFor) << "\n";
+            if (committee)
+            {
+                reportCommittee(activeUsers, network.count, required, votesFor, consensus);
+            }
+        }
+
+        if (!consensus)
+        {
+            if (!silent)
+            {
+                cout << "CONSENSUS FAILED: " << (newUsers.size() == 1 ? "User" : "Users") << " REJECTED\n";
+                cout << "================================================\n\n";
+            }
+            return false;
+        }
+
+        if (!silent)
+            cout << "CONSENSUS REACHED: " << (newUsers.size() == 1 ? "User" : "Users") << " ACCEPTED\n";
+    }
+
+    if (!founding && !verifyJoinSource(network.head->localBlockchain, network, silent))
+    {
+        if (!silent)
+        {
+            cout << "JOIN FAILED: the network's chain could not be verified\n";
+            cout << "================================================\n\n";
+        }
+        return false;
+    }
+
+    size_t first = 0;
+    if (founding)
+    {
+        network.addUser(newUsers[0]);
+        first = 1;
+    }
+    Blockchain* founderChain = network.head->localBlockchain;
+    for (size_t i = first; i < newUsers.size(); i++)
+    {
+        newUsers[i]->localBlockchain->copyFrom(founderChain);
+        network.addUser(newUsers[i]);
+    }
+
+    vector<Transaction> bonuses;
+    bonuses.reserve(newUsers.size());
+    for (size_t i = 0; i < newUsers.size(); i++)
+    {
+        bonuses.push_back(Transaction(SYSTEM_ACCOUNT, newUsers[i]->account, 100 * UNITS_PER_COIN));
+    }
+    for (size_t i = 0; i + 1 < bonuses.size(); i++)
+    {
+        bonuses[i].next = &bonuses[i + 1];
+    }
+    Block* joiningBlock = founderChain->buildBlock("User Joining", &bonuses[0], true);
+    propagateBlock(joiningBlock, network.chains());
+    joiningBlock->release();
+
+    if (!silent)
+    {
+        if (newUsers.size() == 1)
+            cout << ">>> " << newUsers[0]->name << " received $100 joining bonus!\n";
+        else
+            cout << ">>> " << newUsers.size() << " users received a $100 joining bonus each!\n";
+        if (!founding)
+            cout << "================================================\n\n";
+    }
+    return true;
+}
+
+bool consensusOnNewUser(User* newUser, bool silent = false) 
+{
+    return consensusOnNewUsers(vector<User*>(1, newUser), silent);
+}
+
+void displayNetworkUsers() 
+{
+    networkUsers.display();
+}
+
+void displayAllTransactions()
+{
+    if (txPool.size() == 0)
+    {
+        cout << "\nNo pending transactions in pool.\n";
+    }
+    else
+    {
+        cout << "\n--- PENDING TRANSACTIONS ---\n";
+        txPool.display();
+    }
+
+    if (networkUsers.isEmpty())
+    {
+        cout << "\nNo users/confirmed transactions available.\n";
+        return;
+    }
+
+    User* first = networkUsers.head;
+    if (first == NULL || first->localBlockchain == NULL)
+    {
+        cout << "\nNo confirmed transactions found.\n";
+        return;
+    }
+
+    cout << "\n--- CONFIRMED TRANSACTIONS (from first user's blockchain) ---\n";
+    const vector<Block*>& chain = first->localBlockchain->chain;
+    for (size_t blockIdx = 0; blockIdx < chain.size(); blockIdx++)
+    {
+        Block* b = chain[blockIdx];
+        if (b->transactions != NULL)
+        {
+            cout << "Block " << blockIdx << " (" << b->timestamp << ") - Transactions: " << b->transactionCount << "\n";
+            Transaction* t = b->transactions;
+            while (t != NULL)
+            {
+                t->display();
+                t = t->next;
+            }
+        }
+    }
+    cout << "-----------------------------------------------\n";
+}
+
+bool mineBlock(User* miner, string timestamp, bool silent = false) 
+{
+    if (miner == NULL || !miner->isActive)
+    {
+        if (!silent)
+            cout << "Invalid miner or miner is inactive!\n";
+        return false;
+    }
+
+    // The reward transaction takes one of the block's slots; the rest go
+    // to the highest-fee transactions in the pool, whose fees the miner
+    // collects on top of the reward.
+    int limit = miner->localBlockchain->maxBlockTransactions - 1;
+    vector<Transaction*> selected = txPool.selectBest(limit > 0 ? limit : 0);
+    Amount fees = 0;
+    for (size_t i = 0; i < selected.size(); i++)
+    {
+        fees += selected[i]->fee;
+    }
+
+    Transaction* rewardTx = new Transaction(SYSTEM_ACCOUNT, miner->account, MINING_REWARD + fees);
+    
+    Block* lastBlock = miner->localBlockchain->getLatestBlock();
+    Block* proposedBlock = new Block(timestamp, lastBlock->hash, lastBlock->header.height + 1);
+    
+    proposedBlock->addTransaction(rewardTx);
+    
+    for (size_t i = 0; i < selected.size(); i++)
+    {
+        proposedBlock->addTransaction(selected[i]->clone());
+    }
+    proposedBlock->finalizeTransactions();
+    if (!silent)
+        cout << "\n" << miner->name << " is mining the block...\n";
+    proposedBlock->mineBlock(miner->localBlockchain->difficulty, silent, miner->localBlockchain->miningThreads);
+    
+    if (consensusOnBlock(proposedBlock, lastBlock, silent)) 
+    {
+        propagateBlock(proposedBlock, networkUsers.chains());
+        
+        if (!silent)
+        {
+            cout << "\n>>> " << miner->name << " earned $" << formatAmount(MINING_REWARD) << " mining reward";
+            if (fees != 0)
+            {
+                cout << " + $" << formatAmount(fees) << " in fees";
+            }
+            cout << "!\n";
+            if (txPool.size() > 0)
+            {
+                cout << ">>> " << txPool.size() << " transaction(s) left pending for the next block.\n";
+            }
+        }
+        
+        txPool.confirmSelected();
+        proposedBlock->release();
+        return true;
+    } 
+    else 
+    {
+        txPool.returnSelected();
+        proposedBlock->release();
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Performance benchmarks
+// ---------------------------------------------------------------------------
+
+double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Benchmarks intern thousands of synthetic addresses; this puts the global
+// registry back as it was once they finish, so the interactive session keeps
+// its own account numbering. Nothing holding a benchmark account may
+// outlive it; the shared genesis block is built first for that reason.
+class ScopedAddressRegistry
+{
+private:
+    AddressRegistry saved;
+
+    static const AddressRegistry& withGenesis()
+    {
+        Blockchain::genesisBlock();
+        return addressRegistry;
+    }
+
+public:
+    ScopedAddressRegistry() : saved(withGenesis()) {}
+
+    ~ScopedAddressRegistry()
+    {
+        addressRegistry = saved;
+    }
+};
+
+// The original balance table: 100 fixed buckets of chained nodes and a
+// per-character hash. Kept only as the baseline for the benchmark.
+class ChainedBalanceTable
+{
+private:
+    struct Node
+    {
+        string address;
+        float balance;
+        Node* next;
+
+        Node(string addr, float bal) : address(addr), balance(bal), next(NULL) {}
+    };
+
+    static const int TABLE_SIZE = 100;
+    Node* table[TABLE_SIZE];
+
+    int hashFunction(string key)
+    {
+        int hash = 0;
+        for (int i = 0; i < (int)key.length(); i++)
+        {
+            hash = (hash * 31 + key[i]) % TABLE_SIZE;
+        }
+        return hash;
+    }
+
+public:
+    ChainedBalanceTable()
+    {
+        for (int i = 0; i < TABLE_SIZE; i++)
+        {
+            table[i] = NULL;
+        }
+    }
+
+    ~ChainedBalanceTable()
+    {
+        for (int i = 0; i < TABLE_SIZE; i++)
+        {
+            Node* current = table[i];
+            while (current != NULL)
+            {
+                Node* temp = current;
+                current = current->next;
+                delete temp;
+            }
+        }
+    }
+
+    void updateBalance(string address, float amount)
+    {
+        int index = hashFunction(address);
+        for (Node* current = table[index]; current != NULL; current = current->next)
+        {
+            if (current->address == address)
+            {
+                current->balance += amount;
+                return;
+            }
+        }
 
-    int votesFor = 0;
-    int activeUsers = 0;
+        Node* newNode = new Node(address, amount);
+        newNode->next = table[index];
+        table[index] = newNode;
+    }
 
-    User* temp = networkUsers.head;
-    while (temp != NULL)
+    float getBalance(string address)
     {
-        if (temp->isActive) 
+        int index = hashFunction(address);
+        for (Node* current = table[index]; current != NULL; current = current->next)
         {
-            activeUsers++;
-            if (temp->voteOnUser(newUser)) 
+            if (current->address == address)
             {
-                votesFor++;
+                return current->balance;
             }
         }
-        temp = temp->next;
+        return 0.0;
     }
+};
 
-    if (!silent)
+// The current balance path as the benchmark sees it: intern the address,
+// then index the balance vector.
+class RegistryBalanceTable
+{
+public:
+    AddressRegistry registry;
+    BalanceTable balances;
+
+    void updateBalance(const string& address, Amount amount)
     {
-        cout << "\n--- Voting Results ---\n";
-        cout << "Active Users: " << activeUsers << "\n";
-        cout << "Votes FOR: " << votesFor << "\n";
-        cout << "Votes AGAINST: " << (activeUsers - votesFor) << "\n";
+        balances.updateBalance(registry.intern(address), amount);
     }
 
-    bool consensus = (votesFor > activeUsers / 2);
-    
-    if (consensus) 
+    Amount getBalance(const string& address)
     {
-        if (!silent)
-            cout << "CONSENSUS REACHED: User ACCEPTED\n";
-        
-        User* firstUser = networkUsers.head;
-        if (firstUser->localBlockchain != NULL) 
+        AccountId account = registry.find(address);
+        return account == NO_ACCOUNT ? 0 : balances.getBalance(account);
+    }
+};
+
+// Inserts every address once into a fresh table, then looks all of them up
+// in shuffled order. Small tables are rebuilt `rounds` times so the timings
+// are not lost in timer and allocator noise.
+template <typename Table>
+void timeBalanceTable(const char* label, const vector<string>& addresses, const vector<size_t>& order,
+                      int rounds)
+{
+    double insertSeconds = 0;
+    double lookupSeconds = 0;
+    bool correct = true;
+
+    for (int r = 0; r < rounds; r++)
+    {
+        Table* table = new Table();
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < addresses.size(); i++)
         {
-            newUser->localBlockchain->copyFrom(firstUser->localBlockchain);
+            table->updateBalance(addresses[i], 1);
         }
-        
-        networkUsers.addUser(newUser);
-        
-        Transaction* bonusTx = new Transaction("System", newUser->address, 100);
-        User* userTemp = networkUsers.head;
-        while (userTemp != NULL)
+        insertSeconds += secondsSince(start);
+
+        double total = 0;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < order.size(); i++)
         {
-            Transaction* txCopy = new Transaction(bonusTx->fromAddress, 
-                                                  bonusTx->toAddress, 
-                                                  bonusTx->amount);
-            userTemp->localBlockchain->addBlock("User Joining", txCopy, true);
-            userTemp = userTemp->next;
+            total += table->getBalance(addresses[order[i]]);
         }
-        
-        if (!silent)
-            cout << ">>> " << newUser->name << " received $100 joining bonus!\n";
-    } 
-    else 
+        lookupSeconds += secondsSince(start);
+        correct = correct && total == (double)order.size();
+
+        delete table;
+    }
+
+    double operations = (double)addresses.size() * rounds;
+    cout << "  " << label << ": insert " << insertSeconds * 1e9 / operations << " ns/op, lookup "
+         << lookupSeconds * 1e9 / operations << " ns/op" << (correct ? "" : " (MISMATCH)") << "\n";
+}
+
+void benchmarkBalanceTables()
+{
+    const size_t sizes[] = { 1000, 100000, 10000000 };
+    // Beyond this the chained table's 100 buckets hold chains of 100k+
+    // nodes and a single run takes hours, so only the new table is timed.
+    const size_t chainedLimit = 100000;
+
+    cout << "\n=== Balance Table Benchmark ===\n";
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
     {
-        if (!silent)
-            cout << "CONSENSUS FAILED: User REJECTED\n";
+        size_t n = sizes[s];
+        vector<string> addresses(n);
+        vector<size_t> order(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            addresses[i] = "@acct" + to_string(i);
+            order[i] = i;
+        }
+        shuffle(order.begin(), order.end(), mt19937(12345));
+
+        int rounds = n < 100000 ? (int)(1000000 / n) : 1;
+        cout << n << " accounts:\n";
+        timeBalanceTable<RegistryBalanceTable>("open addressing", addresses, order, rounds);
+        if (n <= chainedLimit)
+        {
+            timeBalanceTable<ChainedBalanceTable>("chained (old)  ", addresses, order, rounds);
+        }
+        else
+        {
+            cout << "  chained (old)  : skipped, chains would average " << n / 100 << " nodes\n";
+        }
     }
-    
-    if (!silent)
-        cout << "================================================\n\n";
-    
-    return consensus;
+    cout << "===============================\n";
 }
 
-void displayNetworkUsers() 
+// Random transfers between `accounts` IDs, chained into one block's list.
+Transaction* makeBenchmarkBlock(size_t transactions, AccountId accounts, mt19937& rng)
 {
-    networkUsers.display();
+    Transaction* head = NULL;
+    for (size_t i = 0; i < transactions; i++)
+    {
+        Transaction* tx = new Transaction((AccountId)(rng() % accounts), (AccountId)(rng() % accounts),
+                                          (Amount)(rng() % (1000 * UNITS_PER_COIN)));
+        tx->next = head;
+        head = tx;
+    }
+    return head;
 }
 
-void displayAllTransactions()
+void deleteTransactions(Transaction* head)
 {
-    if (txPool.count == 0)
+    while (head != NULL)
     {
-        cout << "\nNo pending transactions in pool.\n";
+        Transaction* temp = head;
+        head = head->next;
+        delete temp;
     }
-    else
+}
+
+// Registers `count` synthetic addresses named prefix0, prefix1, ...;
+// transaction IDs hash the addresses, so benchmark accounts need them.
+vector<AccountId> internBenchmarkAccounts(const string& prefix, size_t count)
+{
+    vector<AccountId> ids(count);
+    for (size_t i = 0; i < count; i++)
     {
-        cout << "\n--- PENDING TRANSACTIONS ---\n";
-        txPool.display();
+        ids[i] = addressRegistry.intern(prefix + to_string(i));
     }
+    return ids;
+}
 
-    if (networkUsers.isEmpty())
+// A block of `blockSize` random transfers between `accounts` on top of
+// `previous`, mined at difficulty 1 if `mine` is set so header checks accept it.
+Block* makeRandomBlock(Block* previous, const vector<AccountId>& accounts, size_t blockSize, mt19937& rng,
+                       bool mine)
+{
+    Block* block = new Block("benchmark", previous->hash, previous->header.height + 1);
+    for (size_t i = 0; i < blockSize; i++)
     {
-        cout << "\nNo users/confirmed transactions available.\n";
-        return;
+        block->addTransaction(new Transaction(accounts[rng() % accounts.size()], accounts[rng() % accounts.size()],
+                                              (Amount)(rng() % (1000 * UNITS_PER_COIN))));
+    }
+    block->finalizeTransactions();
+    if (mine)
+    {
+        block->mineBlock(1, true, 1);
     }
+    return block;
+}
 
-    User* first = networkUsers.head;
-    if (first == NULL || first->localBlockchain == NULL)
+void appendRandomBlocks(Blockchain& chain, const vector<AccountId>& accounts, size_t count, size_t blockSize,
+                        mt19937& rng, bool mine)
+{
+    for (size_t b = 0; b < count; b++)
     {
-        cout << "\nNo confirmed transactions found.\n";
-        return;
+        chain.appendBlock(makeRandomBlock(chain.getLatestBlock(), accounts, blockSize, rng, mine));
+    }
+}
+
+// Applies the same blocks to one balance table, then to a set of replicas
+// as block propagation does: either block by block on every table, or netted
+// once into a BalanceDelta that every table reuses. The reversed copy of
+// each block checks that the result does not depend on transaction order.
+void benchmarkBlockApply()
+{
+    const AccountId accountCounts[] = { 1000, 100000 };
+    const size_t blockSizes[] = { 100, 10000 };
+    const size_t totalTransactions = 1000000;
+    const int replicas = 8;
+
+    cout << "\n=== Block Apply Benchmark ===\n";
+    for (size_t s = 0; s < 4; s++)
+    {
+        AccountId accounts = accountCounts[s / 2];
+        size_t blockSize = blockSizes[s % 2];
+        size_t blockCount = totalTransactions / blockSize;
+        mt19937 rng(777);
+        vector<Transaction*> blocks(blockCount);
+        vector<Transaction*> reversed(blockCount);
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            blocks[b] = makeBenchmarkBlock(blockSize, accounts, rng);
+            for (Transaction* tx = blocks[b]; tx != NULL; tx = tx->next)
+            {
+                Transaction* copy = tx->clone();
+                copy->next = reversed[b];
+                reversed[b] = copy;
+            }
+        }
+
+        vector<BalanceTable> perTable(replicas);
+        vector<BalanceTable> shared(replicas);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            perTable[0].applyTransactions(blocks[b]);
+        }
+        double singleSeconds = secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            for (int r = 1; r < replicas; r++)
+            {
+                perTable[r].applyTransactions(blocks[b]);
+            }
+        }
+        double perTableSeconds = secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            BalanceDelta delta(blocks[b]);
+            for (int r = 1; r < replicas; r++)
+            {
+                shared[r].apply(delta);
+            }
+        }
+        double sharedSeconds = secondsSince(start);
+
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            shared[0].apply(BalanceDelta(reversed[b]));
+        }
+
+        bool identical = true;
+        for (AccountId a = 0; a < accounts; a++)
+        {
+            Amount expected = perTable[0].getBalance(a);
+            for (int r = 0; r < replicas; r++)
+            {
+                identical = identical && perTable[r].getBalance(a) == expected &&
+                            shared[r].getBalance(a) == expected;
+            }
+        }
+
+        double replicaTransactions = (double)totalTransactions * (replicas - 1);
+        cout << accounts << " accounts, " << blockSize << " tx per block:\n";
+        cout << "  1 table               : " << (size_t)(totalTransactions / singleSeconds) << " tx/s\n";
+        cout << "  " << (replicas - 1) << " tables, block each  : "
+             << (size_t)(replicaTransactions / perTableSeconds) << " tx/s\n";
+        cout << "  " << (replicas - 1) << " tables, shared delta: "
+             << (size_t)(replicaTransactions / sharedSeconds) << " tx/s\n";
+        cout << "  balances identical (incl. reversed order): " << (identical ? "yes" : "NO") << "\n";
+
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            deleteTransactions(blocks[b]);
+            deleteTransactions(reversed[b]);
+        }
+    }
+    cout << "=============================\n";
+}
+
+// Producers push pre-built transactions through submitWait() while one
+// consumer plays the miner, draining the pool and freeing what it takes.
+void benchmarkPoolSubmission()
+{
+    const int producerCounts[] = { 1, 2, 4, 8 };
+    const size_t totalTransactions = 2000000;
+    const int capacity = 65536;
+
+    cout << "\n=== Transaction Pool Submission Benchmark ===\n";
+    cout << "(capacity " << capacity << ", " << thread::hardware_concurrency() << " hardware threads)\n";
+    for (size_t p = 0; p < sizeof(producerCounts) / sizeof(producerCounts[0]); p++)
+    {
+        int producers = producerCounts[p];
+        size_t perProducer = totalTransactions / producers;
+        vector<vector<Transaction*> > work(producers);
+        for (int t = 0; t < producers; t++)
+        {
+            work[t].reserve(perProducer);
+            for (size_t i = 0; i < perProducer; i++)
+            {
+                work[t].push_back(new Transaction((AccountId)t, (AccountId)i, 1));
+            }
+        }
+
+        TransactionPool pool(capacity);
+        atomic<int> finished(0);
+        size_t consumed = 0;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int t = 0; t < producers; t++)
+        {
+            threads.push_back(thread([&pool, &work, &finished, t]() {
+                for (size_t i = 0; i < work[t].size(); i++)
+                {
+                    pool.submitWait(work[t][i]);
+                }
+                finished++;
+            }));
+        }
+
+        while (true)
+        {
+            bool done = finished.load() == producers;
+            int pending = pool.size();
+            consumed += pending;
+            pool.clear();
+            if (done && pending == 0)
+            {
+                break;
+            }
+            if (pending == 0)
+            {
+                this_thread::yield();
+            }
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            threads[t].join();
+        }
+        double seconds = secondsSince(start);
+
+        cout << "  " << producers << " producer(s): " << (size_t)(consumed / seconds) << " tx/s"
+             << (consumed == perProducer * producers ? "" : " (LOST TRANSACTIONS)") << "\n";
+    }
+    cout << "=============================================\n";
+}
+
+// Builds a chain of unmined blocks, then compares reading one page of an
+// address's history through the index against scanning every block.
+void benchmarkHistory()
+{
+    const size_t totalTransactions = 2000000;
+    const size_t blockSize = 1000;
+    const size_t accounts = 10000;
+    const size_t pageSize = 10;
+    const int queries = 10000;
+    const int scans = 5;
+
+    cout << "\n=== Address History Benchmark ===\n";
+    mt19937 rng(4242);
+    Blockchain blockchain;
+    vector<AccountId> ids = internBenchmarkAccounts("@history", accounts);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    appendRandomBlocks(blockchain, ids, totalTransactions / blockSize, blockSize, rng, false);
+    cout << "  Built and indexed " << totalTransactions << " transactions in "
+         << secondsSince(start) << " s\n";
+
+    start = chrono::steady_clock::now();
+    size_t found = 0;
+    for (int q = 0; q < queries; q++)
+    {
+        AccountId account = ids[rng() % accounts];
+        size_t pages = (blockchain.getHistoryCount(account) + pageSize - 1) / pageSize;
+        size_t page = pages == 0 ? 0 : rng() % pages;
+        found += blockchain.getHistory(account, page * pageSize, pageSize).size();
+    }
+    double indexed = secondsSince(start) / queries;
+
+    start = chrono::steady_clock::now();
+    size_t scanned = 0;
+    for (int q = 0; q < scans; q++)
+    {
+        AccountId account = ids[rng() % accounts];
+        for (size_t height = 0; height < blockchain.chain.size(); height++)
+        {
+            for (Transaction* tx = blockchain.chain[height]->transactions; tx != NULL; tx = tx->next)
+            {
+                if (tx->from == account || tx->to == account)
+                {
+                    scanned++;
+                }
+            }
+        }
+    }
+    double scan = secondsSince(start) / scans;
+
+    cout << "  Indexed page of " << pageSize << ": " << indexed * 1e6 << " us/query ("
+         << found << " entries read)\n";
+    cout << "  Full chain scan:   " << scan * 1e6 << " us/query (" << scanned << " matches)\n";
+    cout << "=============================================\n";
+}
+
+// Propagates the same blocks to many chains, once while all of them share
+// one state and once with a private state per chain, as when every user
+// applied each block to its own tables.
+void benchmarkPropagation()
+{
+    const size_t userCounts[] = { 100, 1000, 10000 };
+    const size_t blockCount = 20;
+    const size_t blockSize = MAX_BLOCK_TRANSACTIONS;
+    const size_t accounts = 10000;
+
+    cout << "\n=== Block Propagation Benchmark ===\n";
+    vector<AccountId> ids = internBenchmarkAccounts("@peer", accounts);
+
+    for (size_t u = 0; u < sizeof(userCounts) / sizeof(userCounts[0]); u++)
+    {
+        size_t users = userCounts[u];
+        mt19937 rng(99);
+        Blockchain base;
+
+        vector<Block*> blocks;
+        Block* previous = base.getLatestBlock();
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            previous = makeRandomBlock(previous, ids, blockSize, rng, false);
+            blocks.push_back(previous);
+        }
+
+        // Diverged states hold a full index per user, so the largest run
+        // only measures the shared case.
+        for (int privateStates = 0; privateStates < (users <= 1000 ? 2 : 1); privateStates++)
+        {
+            vector<Blockchain*> chains(users);
+            for (size_t i = 0; i < users; i++)
+            {
+                chains[i] = new Blockchain();
+                chains[i]->copyFrom(&base);
+                if (privateStates)
+                {
+                    chains[i]->writableState();
+                }
+            }
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for (size_t b = 0; b < blockCount; b++)
+            {
+                propagateBlock(blocks[b], chains);
+            }
+            double seconds = secondsSince(start);
+
+            cout << "  " << users << " users, " << (privateStates ? "private states" : "shared state  ")
+                 << ": " << seconds / blockCount * 1e3 << " ms/block ("
+                 << "sample balance $" << formatAmount(chains[0]->getBalance(ids[0])) << ")\n";
+
+            for (size_t i = 0; i < users; i++)
+            {
+                delete chains[i];
+            }
+        }
+
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            blocks[b]->release();
+        }
+    }
+    cout << "=============================================\n";
+}
+
+// Validates one long chain from genesis on one thread and on all of them,
+// then measures the incremental check a vote runs after one new block.
+void benchmarkValidation()
+{
+    const size_t blockCount = 20000;
+    const size_t blockSize = MAX_BLOCK_TRANSACTIONS;
+    const size_t accounts = 10000;
+    const int rounds = 3;
+
+    cout << "\n=== Chain Validation Benchmark ===\n";
+    vector<AccountId> ids = internBenchmarkAccounts("@peer", accounts);
+
+    mt19937 rng(1234);
+    Blockchain blockchain;
+    appendRandomBlocks(blockchain, ids, blockCount, blockSize, rng, false);
+    {
+        // One more block, appended after a full check to time the incremental one.
+        blockchain.isChainValid(true);
+        blockchain.appendBlock(makeRandomBlock(blockchain.getLatestBlock(), ids, blockSize, rng, false));
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool valid = blockchain.isChainValid();
+        cout << "  Incremental check after one new block: " << secondsSince(start) * 1e3 << " ms"
+             << (valid ? "" : " (INVALID)") << "\n";
+    }
+
+    int threadCounts[] = { 1, Blockchain::defaultMiningThreads() };
+    for (int t = 0; t < 2; t++)
+    {
+        blockchain.miningThreads = threadCounts[t];
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool valid = true;
+        for (int r = 0; r < rounds; r++)
+        {
+            valid = blockchain.isChainValid(true) && valid;
+        }
+        cout << "  Full check, " << threadCounts[t] << " thread(s): "
+             << secondsSince(start) / rounds * 1e3 << " ms for " << blockchain.getBlockCount() << " blocks"
+             << (valid ? "" : " (INVALID)") << "\n";
+    }
+
+    size_t tampered = blockCount / 2;
+    blockchain.getWritableBlock((int)tampered)->transactions->amount++;
+    blockchain.isChainValid(true);
+    cout << "  After tampering block #" << tampered << ", first invalid block: #"
+         << blockchain.verifiedHeight << "\n";
+    cout << "=============================================\n";
+}
+
+// One round of voting on a full block by many validators whose chains
+// share a 200-block history: every validator polled in turn and hashing
+// the block itself, as consensus used to run, against the worker pool that
+// stops at a majority and shares one verification of the block.
+void benchmarkVoting()
+{
+    const size_t validatorCounts[] = { 1000, 5000 };
+    const size_t chainLength = 200;
+
+    cout << "\n=== Consensus Voting Benchmark ===\n";
+    cout << "(" << thread::hardware_concurrency() << " hardware threads)\n";
+    for (size_t v = 0; v < sizeof(validatorCounts) / sizeof(validatorCounts[0]); v++)
+    {
+        size_t validators = validatorCounts[v];
+        Blockchain base;
+        for (size_t b = 0; b < chainLength; b++)
+        {
+            Transaction reward(SYSTEM_ACCOUNT, SYSTEM_ACCOUNT, MINING_REWARD);
+            base.addBlock("benchmark", &reward, true);
+        }
+        vector<Transaction> payments(MAX_BLOCK_TRANSACTIONS, Transaction(SYSTEM_ACCOUNT, SYSTEM_ACCOUNT, 1));
+        for (size_t i = 0; i + 1 < payments.size(); i++)
+        {
+            payments[i].next = &payments[i + 1];
+        }
+        Block* proposed = base.buildBlock("proposed", &payments[0], true);
+        base.isChainValid();    // validators inherit the checkpoint, as they would after earlier rounds
+
+        // Separate validator sets, so the first round does not leave the
+        // second with already verified chains.
+        vector<User*> sequential(validators);
+        vector<User*> pooled(validators);
+        for (size_t i = 0; i < validators; i++)
+        {
+            sequential[i] = new User("@validator" + to_string(i), "Validator");
+            sequential[i]->localBlockchain->copyFrom(&base);
+            pooled[i] = new User("@validator" + to_string(i), "Validator");
+            pooled[i]->localBlockchain->copyFrom(&base);
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int votesFor = 0;
+        string reason;
+        for (size_t i = 0; i < validators; i++)
+        {
+            verificationCache.clear();
+            votesFor += sequential[i]->voteOnBlock(proposed, base.getLatestBlock(), reason) ? 1 : 0;
+        }
+        double sequentialSeconds = secondsSince(start);
+        verificationCache.endRound();
+
+        // The pool first polls every validator, then stops at a majority, so
+        // the shared cache and the early stop are timed apart.
+        verificationCache.clear();
+        start = chrono::steady_clock::now();
+        vector<VoteRecord> records;
+        int everyFor = collectVotes(pooled, proposed, base.getLatestBlock(), records, (int)validators);
+        double everySeconds = secondsSince(start);
+        verificationCache.endRound();
+        size_t everyHashed = verificationCache.misses;
+
+        verificationCache.clear();
+        start = chrono::steady_clock::now();
+        int pooledFor = collectVotes(pooled, proposed, base.getLatestBlock(), records, (int)validators / 2 + 1);
+        double pooledSeconds = secondsSince(start);
+        verificationCache.endRound();
+
+        cout << "  " << validators << " validators:\n"
+             << "    every vote in turn, uncached: " << sequentialSeconds * 1e3 << " ms ("
+             << votesFor << " for)\n"
+             << "    pool, every vote, shared cache: " << everySeconds * 1e3 << " ms ("
+             << everyFor << " for, block hashed " << everyHashed << " time(s))\n"
+             << "    pool, early stop, shared cache: " << pooledSeconds * 1e3 << " ms ("
+             << pooledFor << " for, block hashed " << verificationCache.misses << " time(s), p50 "
+             << voteLatencyPercentile(records, 50) * 1e6 << " us, p99 "
+             << voteLatencyPercentile(records, 99) * 1e6 << " us)\n";
+
+        for (size_t i = 0; i < validators; i++)
+        {
+            delete sequential[i];
+            delete pooled[i];
+        }
+        proposed->release();
+    }
+    cout << "=============================================\n";
+}
+
+// A round of block voting on large networks where one user in ten is
+// offline, with every active user voting and with a sampled committee.
+void benchmarkCommittee()
+{
+    const int networkSizes[] = { 10000, 50000 };
+    const int committeeSize = 200;
+
+    cout << "\n=== Committee Consensus Benchmark ===\n";
+    int savedSize = consensusCommitteeSize;
+    for (size_t n = 0; n < sizeof(networkSizes) / sizeof(networkSizes[0]); n++)
+    {
+        int networkSize = networkSizes[n];
+        Blockchain base;
+        base.isChainValid();
+        Transaction payment(SYSTEM_ACCOUNT, SYSTEM_ACCOUNT, 1);
+        Block* proposed = base.buildBlock("proposed", &payment, true);
+
+        UserList network;
+        for (int i = 0; i < networkSize; i++)
+        {
+            User* user = new User("@node" + to_string(i), "Node");
+            user->localBlockchain->copyFrom(&base);
+            user->isActive = i % 10 != 0;
+            network.addUser(user);
+        }
+
+        for (int mode = 0; mode < 2; mode++)
+        {
+            consensusCommitteeSize = mode == 0 ? 0 : committeeSize;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            int required;
+            vector<User*> voters = chooseVoters(network, base.getLatestBlock()->hash, required);
+            vector<VoteRecord> records;
+            int votesFor = collectVotes(voters, proposed, base.getLatestBlock(), records, required);
+            verificationCache.endRound();
+            double seconds = secondsSince(start);
+
+            cout << "  " << networkSize << " users, " << (mode == 0 ? "all active users" : "committee       ")
+                 << ": " << seconds * 1e3 << " ms, " << votesFor << "/" << voters.size() << " for, needs "
+                 << required;
+            if (mode == 1)
+            {
+                cout << ", confidence " << committeeConfidence(votesFor, (int)voters.size(), votesFor >= required) * 100
+                     << "%";
+            }
+            cout << "\n";
+        }
+        proposed->release();
     }
+    consensusCommitteeSize = savedSize;
+    cout << "=============================================\n";
+}
 
-    cout << "\n--- CONFIRMED TRANSACTIONS (from first user's blockchain) ---\n";
-    Block* b = first->localBlockchain->chain;
-    int blockIdx = 0;
-    while (b != NULL)
+// Stands up networks one user per vote round, as joining used to work,
+// and in a single batch. Vote output is discarded while the rounds run.
+void benchmarkOnboarding()
+{
+    const size_t networkSizes[] = { 1000, 10000 };
+    const size_t oneByOneLimit = 1000;
+
+    cout << "\n=== User Onboarding Benchmark ===\n";
+    for (size_t n = 0; n < sizeof(networkSizes) / sizeof(networkSizes[0]); n++)
     {
-        if (b->transactions != NULL)
+        size_t users = networkSizes[n];
+        for (int batched = (users > oneByOneLimit ? 1 : 0); batched < 2; batched++)
         {
-            cout << "Block " << blockIdx << " (" << b->timestamp << ") - Transactions: " << b->transactionCount << "\n";
-            Transaction* t = b->transactions;
-            while (t != NULL)
+            vector<User*> newUsers(users);
+            for (size_t i = 0; i < users; i++)
             {
-                t->display();
-                t = t->next;
+                newUsers[i] = new User("@joiner" + to_string(i), "Joiner");
+            }
+
+            UserList network;
+            streambuf* output = cout.rdbuf(NULL);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if (batched)
+            {
+                consensusOnNewUsers(newUsers, true, network);
+            }
+            else
+            {
+                for (size_t i = 0; i < users; i++)
+                {
+                    consensusOnNewUsers(vector<User*>(1, newUsers[i]), true, network);
+                }
             }
+            double seconds = secondsSince(start);
+            cout.rdbuf(output);
+            cout.clear();
+
+            cout << "  " << users << " users, " << (batched ? "one batch:       " : "one at a time:   ")
+                 << seconds * 1e3 << " ms, " << network.head->localBlockchain->getBlockCount()
+                 << " blocks per chain\n";
         }
-        b = b->next;
-        blockIdx++;
     }
-    cout << "-----------------------------------------------\n";
+    cout << "(one-at-a-time runs above " << oneByOneLimit << " users are skipped)\n";
+    cout << "=============================================\n";
 }
 
-bool mineBlock(User* miner, string timestamp, bool silent = false) 
+void benchmarkChainDownload()
 {
-    if (miner == NULL || !miner->isActive)
-    {
-        if (!silent)
-            cout << "Invalid miner or miner is inactive!\n";
-        return false;
-    }
+    const size_t blockCount = 10000;
+    const size_t blockSize = MAX_BLOCK_TRANSACTIONS;
+    const size_t accounts = 10000;
+    const size_t peerCounts[] = { 1, 2, 4, 8 };
 
-    Transaction* rewardTx = new Transaction("System", miner->address, 50);
-    
-    Block* lastBlock = miner->localBlockchain->getLatestBlock();
-    Block* proposedBlock = new Block(timestamp, lastBlock->hash);
-    
-    proposedBlock->addTransaction(rewardTx);
-    
-    Transaction* temp = txPool.head;
-    while (temp != NULL)
+    cout << "\n=== Chain Download Benchmark ===\n";
+    vector<AccountId> ids = internBenchmarkAccounts("@peer", accounts);
+
+    mt19937 rng(1234);
+    Blockchain base;
+    appendRandomBlocks(base, ids, blockCount, blockSize, rng, true);
+
+    size_t most = peerCounts[sizeof(peerCounts) / sizeof(peerCounts[0]) - 1];
+    vector<Blockchain*> network(most);
+    for (size_t i = 0; i < most; i++)
     {
-        Transaction* newTx = new Transaction(temp->fromAddress, 
-                                             temp->toAddress, 
-                                             temp->amount);
-        proposedBlock->addTransaction(newTx);
-        temp = temp->next;
+        network[i] = new Blockchain();
+        network[i]->copyFrom(&base);
     }
-    proposedBlock->finalizeTransactions();
-    if (!silent)
-        cout << "\n" << miner->name << " is mining the block...\n";
-    proposedBlock->mineBlock(miner->localBlockchain->difficulty, silent);
-    
-    if (consensusOnBlock(proposedBlock, lastBlock, silent)) 
+
+    for (int tampered = 0; tampered < 2; tampered++)
     {
-        User* userTemp = networkUsers.head;
-        while (userTemp != NULL)
+        if (tampered)
         {
-            Block* userLastBlock = userTemp->localBlockchain->getLatestBlock();
-            Block* newBlock = new Block(timestamp, userLastBlock->hash);
-            
-            Transaction* txTemp = proposedBlock->transactions;
-            while (txTemp != NULL)
+            // The first peer, which is asked for the first chunk, now serves
+            // an altered block in it.
+            network[0]->getWritableBlock(1)->transactions->amount++;
+        }
+        for (size_t p = 0; p < sizeof(peerCounts) / sizeof(peerCounts[0]); p++)
+        {
+            size_t peerCount = peerCounts[p];
+            if (tampered && peerCount == 1)
             {
-                Transaction* txCopy = new Transaction(txTemp->fromAddress, 
-                                                      txTemp->toAddress, 
-                                                      txTemp->amount);
-                newBlock->addTransaction(txCopy);
-                
-                if (txTemp->fromAddress != "System")
-                {
-                    userTemp->localBlockchain->balanceTable->updateBalance(txTemp->fromAddress, -txTemp->amount);
-                }
-                userTemp->localBlockchain->balanceTable->updateBalance(txTemp->toAddress, txTemp->amount);
-                
-                txTemp = txTemp->next;
+                continue;
             }
-            newBlock->nonce = proposedBlock->nonce;
-            newBlock->hash = proposedBlock->hash;
-            newBlock->txHash = proposedBlock->txHash;
-            
-            userLastBlock->next = newBlock;
-            
-            userTemp = userTemp->next;
+            vector<Blockchain*> peers(network.begin(), network.begin() + peerCount);
+            Blockchain target;
+            SyncReport report;
+            bool synced = syncChain(&target, peers, report);
+            bool matches = synced && target.stateDigest() == base.stateDigest();
+            cout << "  " << peerCount << " peer(s)" << (tampered ? ", one bad: " : ":         ")
+                 << report.seconds * 1e3 << " ms for " << report.blocks << " blocks, " << report.retries
+                 << " retries" << (matches ? "" : " (MISMATCH)") << "\n";
         }
-        
-        if (!silent)
-            cout << "\n>>> " << miner->name << " earned $50 mining reward!\n";
-        
-        txPool.clear();
-        delete proposedBlock;
-        return true;
-    } 
-    else 
+    }
+    cout << "(peers are fetched from concurrently, up to " << Blockchain::defaultMiningThreads()
+         << " threads on this machine)\n";
+
+    for (size_t i = 0; i < most; i++)
     {
-        delete proposedBlock;
-        return false;
+        delete network[i];
+    }
+    cout << "================================\n";
+}
+
+void runBenchmarks()
+{
+    cout << "\n=== Performance Benchmarks ===\n";
+    cout << "1. Balance table (1k / 100k / 10M accounts)\n";
+    cout << "2. Block balance apply (tx/s)\n";
+    cout << "3. Transaction pool submission (1-8 producers)\n";
+    cout << "4. Address history reads (2M transactions)\n";
+    cout << "5. Block propagation (100 / 1k / 10k users)\n";
+    cout << "6. Chain validation (full / parallel / incremental)\n";
+    cout << "7. Consensus voting (1k / 5k validators)\n";
+    cout << "8. Committee consensus (10k / 50k users)\n";
+    cout << "9. User onboarding (one at a time / batched)\n";
+    cout << "10. Chunked chain download (1-8 peers)\n";
+    cout << "0. Back\n";
+    cout << "Enter option: ";
+    int option;
+    cin >> option;
+    cin.ignore(10000, '\n');
+
+    ScopedAddressRegistry registry;
+    switch (option)
+    {
+        case 1:
+            benchmarkBalanceTables();
+            break;
+        case 2:
+            benchmarkBlockApply();
+            break;
+        case 3:
+            benchmarkPoolSubmission();
+            break;
+        case 4:
+            benchmarkHistory();
+            break;
+        case 5:
+            benchmarkPropagation();
+            break;
+        case 6:
+            benchmarkValidation();
+            break;
+        case 7:
+            benchmarkVoting();
+            break;
+        case 8:
+            benchmarkCommittee();
+            break;
+        case 9:
+            benchmarkOnboarding();
+            break;
+        case 10:
+            benchmarkChainDownload();
+            break;
+        case 0:
+            break;
+        default:
+            cout << "Invalid option!\n";
     }
 }
 
@@ -1035,6 +4113,14 @@ void displayMenu()
     cout << "10. Set Difficulty\n";
     cout << "11. Tamper with User's Block\n";
     cout << "12. Display All Transactions\n";
+    cout << "13. Set Mining Threads\n";
+    cout << "14. Verify Transaction Inclusion\n";
+    cout << "15. Run Performance Benchmarks\n";
+    cout << "16. Set Max Transactions per Block\n";
+    cout << "17. Find Block or Transaction by Hash\n";
+    cout << "18. View Address History\n";
+    cout << "19. Set Consensus Committee Size\n";
+    cout << "20. Resync User's Blockchain from Peers\n";
     cout << "0.  Exit\n";
     cout << "=====================================\n";
     cout << "Enter choice: ";
@@ -1045,7 +4131,14 @@ int main()
     system ("color F0");
     srand(time(0));
     cout << "========== Simple Blockchain Simulation ==========\n\n";
-    
+
+    cout << "SHA-256 backend: " << sha256_active_backend().name;
+    if (!sha256_self_test())
+    {
+        cout << " (WARNING: a backend failed its known-answer test)";
+    }
+    cout << "\n\n";
+
     User* huzaif = new User("@huzaif", "Huzaif");
     User* hardeep = new User("@hardeep", "Hardeep");
     User* kazim = new User("@kazim", "Kazim");
@@ -1064,9 +4157,9 @@ int main()
         cout << "Generating 10 blocks...\n";
         cout.flush();
 
-        Transaction* tx1 = new Transaction("@huzaif", "@hardeep", 50);
-        if (networkUsers.getUserByAddress(tx1->fromAddress) != NULL &&
-            networkUsers.getUserByAddress(tx1->fromAddress)->localBlockchain->getBalance(tx1->fromAddress) >= tx1->amount)
+        Transaction* tx1 = new Transaction("@huzaif", "@hardeep", 50 * UNITS_PER_COIN);
+        if (networkUsers.getUserByAccount(tx1->from) != NULL &&
+            networkUsers.getUserByAccount(tx1->from)->localBlockchain->getBalance(tx1->from) >= tx1->amount)
         {
             txPool.addTransaction(tx1);
         }
@@ -1077,9 +4170,9 @@ int main()
 
         mineBlock(hardeep, "Block_1", true);
 
-        Transaction* tx2 = new Transaction("@hardeep", "@kazim", 50);
-        if (networkUsers.getUserByAddress(tx2->fromAddress) != NULL &&
-            networkUsers.getUserByAddress(tx2->fromAddress)->localBlockchain->getBalance(tx2->fromAddress) >= tx2->amount)
+        Transaction* tx2 = new Transaction("@hardeep", "@kazim", 50 * UNITS_PER_COIN);
+        if (networkUsers.getUserByAccount(tx2->from) != NULL &&
+            networkUsers.getUserByAccount(tx2->from)->localBlockchain->getBalance(tx2->from) >= tx2->amount)
         {
             txPool.addTransaction(tx2);
         }
@@ -1090,9 +4183,9 @@ int main()
 
         mineBlock(kazim, "Block_2", true);
 
-        Transaction* tx3 = new Transaction("@kazim", "@huzaif", 50);
-        if (networkUsers.getUserByAddress(tx3->fromAddress) != NULL &&
-            networkUsers.getUserByAddress(tx3->fromAddress)->localBlockchain->getBalance(tx3->fromAddress) >= tx3->amount)
+        Transaction* tx3 = new Transaction("@kazim", "@huzaif", 50 * UNITS_PER_COIN);
+        if (networkUsers.getUserByAccount(tx3->from) != NULL &&
+            networkUsers.getUserByAccount(tx3->from)->localBlockchain->getBalance(tx3->from) >= tx3->amount)
         {
             txPool.addTransaction(tx3);
         }
@@ -1172,15 +4265,24 @@ int main()
                 break;
             }
             case 4: {
-                string from, to;
-                float amount;
+                string from, to, amountText, feeText;
+                Amount amount;
+                Amount fee = 0;
                 cout << "From Address: ";
                 getline(cin, from);
                 cout << "To Address: ";
                 getline(cin, to);
                 cout << "Amount: ";
-                cin >> amount;
-                cin.ignore(10000, '\n');
+                getline(cin, amountText);
+                cout << "Fee (Enter for none): ";
+                getline(cin, feeText);
+                
+                if (!parseAmount(amountText, amount) || amount == 0 ||
+                    (!feeText.empty() && !parseAmount(feeText, fee)))
+                {
+                    cout << "Invalid amount! Use up to two decimal places.\n";
+                    break;
+                }
                 
                 User* sender = networkUsers.getUserByAddress(from);
                 if (sender == NULL)
@@ -1189,15 +4291,20 @@ int main()
                     break;
                 }
                 
-                if (sender->localBlockchain->getBalance(from) < amount)
+                if (sender->localBlockchain->getBalance(sender->account) < amount + fee)
                 {
                     cout << "Insufficient balance! Balance: $"
-                         << sender->localBlockchain->getBalance(from) << "\n";
+                         << formatAmount(sender->localBlockchain->getBalance(sender->account)) << "\n";
                     break;
                 }
                 
-                Transaction* tx = new Transaction(from, to, amount);
-                txPool.addTransaction(tx);
+                Transaction* tx = new Transaction(sender->account, addressRegistry.intern(to), amount, fee);
+                if (!txPool.addTransaction(tx))
+                {
+                    delete tx;
+                    cout << "Transaction pool is full! Mine a block and try again.\n";
+                    break;
+                }
                 cout << "Transaction added to pool!\n";
                 break;
             }
@@ -1255,13 +4362,14 @@ int main()
                 if (user != NULL && user->localBlockchain != NULL)
                 {
                     cout << "\nValidating " << user->name << "'s blockchain...\n";
-                    if (user->localBlockchain->isChainValid())
+                    if (user->localBlockchain->isChainValid(true))
                     {
                         cout << "Blockchain is valid!\n";
                     }
                     else
                     {
-                        cout << "Blockchain is INVALID!\n";
+                        cout << "Blockchain is INVALID! First invalid block: #"
+                             << user->localBlockchain->verifiedHeight << "\n";
                     }
                 }
                 else
@@ -1288,9 +4396,9 @@ int main()
                 cout << "Enter address to check: ";
                 getline(cin, address);
                 
-                float balance = user->localBlockchain->getBalance(address);
+                Amount balance = user->localBlockchain->getBalance(address);
                 cout << "Balance of " << address << " (in " << user->name
-                     << "'s blockchain): $" << balance << endl;
+                     << "'s blockchain): $" << formatAmount(balance) << endl;
                 break;
             }
             case 10: {
@@ -1352,11 +4460,10 @@ int main()
                     break;
                 }
                 
-                Block* targetBlock = user->localBlockchain->chain;
-                for (int i = 0; i < blockNum; i++)
-                {
-                    targetBlock = targetBlock->next;
-                }
+                // Read-only until the change is known to be valid: taking the
+                // writable block clones it and lowers the validation checkpoint.
+                Block* targetBlock = user->localBlockchain->getBlock(blockNum);
+                bool tampered = false;
                 
                 cout << "\n=== Tampering Options ===\n";
                 cout << "1. Change timestamp\n";
@@ -1370,23 +4477,32 @@ int main()
                 switch(tamperOption)
                 {
                     case 1: {
-                        string newTimestamp;
-                        cout << "Current timestamp: " << targetBlock->timestamp << "\n";
-                        cout << "Enter new timestamp: ";
-                        getline(cin, newTimestamp);
-                        targetBlock->timestamp = newTimestamp;
+                        unsigned long long newTimestamp;
+                        cout << "Current timestamp: " << targetBlock->timestamp
+                             << " (" << targetBlock->header.timestamp << ")\n";
+                        cout << "Enter new timestamp (seconds since epoch): ";
+                        cin >> newTimestamp;
+                        cin.ignore(10000, '\n');
+                        user->localBlockchain->getWritableBlock(blockNum)->header.timestamp = newTimestamp;
+                        tampered = true;
                         cout << "Timestamp changed!\n";
                         break;
                     }
                     case 2: {
                         if (targetBlock->transactions != NULL)
                         {
-                            float newAmount;
-                            cout << "Current amount: " << targetBlock->transactions->amount << "\n";
+                            string amountText;
+                            Amount newAmount;
+                            cout << "Current amount: " << formatAmount(targetBlock->transactions->amount) << "\n";
                             cout << "Enter new amount: ";
-                            cin >> newAmount;
-                            cin.ignore(10000, '\n');
-                            targetBlock->transactions->amount = newAmount;
+                            getline(cin, amountText);
+                            if (!parseAmount(amountText, newAmount))
+                            {
+                                cout << "Invalid amount!\n";
+                                break;
+                            }
+                            user->localBlockchain->getWritableBlock(blockNum)->transactions->amount = newAmount;
+                            tampered = true;
                             cout << "Transaction amount changed!\n";
                         }
                         else
@@ -1396,12 +4512,13 @@ int main()
                         break;
                     }
                     case 3: {
-                        int newNonce;
-                        cout << "Current nonce: " << targetBlock->nonce << "\n";
+                        unsigned long long newNonce;
+                        cout << "Current nonce: " << targetBlock->header.nonce << "\n";
                         cout << "Enter new nonce: ";
                         cin >> newNonce;
                         cin.ignore(10000, '\n');
-                        targetBlock->nonce = newNonce;
+                        user->localBlockchain->getWritableBlock(blockNum)->header.nonce = newNonce;
+                        tampered = true;
                         cout << "Nonce changed!\n";
                         break;
                     }
@@ -1409,14 +4526,287 @@ int main()
                         cout << "Invalid option!\n";
                 }
                 
-                cout << "\n>>> Block has been tampered with!\n";
-                cout << ">>> Run validation to see the effect.\n";
+                if (tampered)
+                {
+                    cout << "\n>>> Block has been tampered with!\n";
+                    cout << ">>> Run validation to see the effect.\n";
+                }
                 break;
             }
             case 12: {
                 displayAllTransactions();
                 break;
             }
+            case 13: {
+                displayNetworkUsers();
+                int idx;
+                cout << "User number: ";
+                cin >> idx;
+                cin.ignore(10000, '\n');
+                
+                User* user = networkUsers.getUserAt(idx - 1);
+                if (user != NULL && user->localBlockchain != NULL)
+                {
+                    int newThreads;
+                    cout << "Current mining threads: " << user->localBlockchain->miningThreads << "\n";
+                    cout << "Enter number of mining threads (1-256): ";
+                    cin >> newThreads;
+                    cin.ignore(10000, '\n');
+                    
+                    if (newThreads >= 1 && newThreads <= 256)
+                    {
+                        user->localBlockchain->miningThreads = newThreads;
+                        cout << "Mining threads set to " << newThreads << " for " << user->name << "\n";
+                    }
+                    else
+                    {
+                        cout << "Invalid thread count! Must be between 1 and 256.\n";
+                    }
+                }
+                else
+                {
+                    cout << "Invalid user!\n";
+                }
+                break;
+            }
+            case 14: {
+                displayNetworkUsers();
+                int idx;
+                cout << "User number: ";
+                cin >> idx;
+                cin.ignore(10000, '\n');
+                
+                User* user = networkUsers.getUserAt(idx - 1);
+                if (user == NULL || user->localBlockchain == NULL)
+                {
+                    cout << "Invalid user!\n";
+                    break;
+                }
+                
+                int blockCount = user->localBlockchain->getBlockCount();
+                cout << "Enter block number (0-" << (blockCount - 1) << "): ";
+                int blockNum;
+                cin >> blockNum;
+                cin.ignore(10000, '\n');
+                
+                if (blockNum < 0 || blockNum >= blockCount)
+                {
+                    cout << "Invalid block number!\n";
+                    break;
+                }
+                
+                Block* targetBlock = user->localBlockchain->getBlock(blockNum);
+                
+                cout << "Enter transaction index (0-" << (targetBlock->transactionCount - 1) << "): ";
+                int txIndex;
+                cin >> txIndex;
+                cin.ignore(10000, '\n');
+                
+                Transaction* tx = targetBlock->getTransaction(txIndex);
+                if (txIndex < 0 || tx == NULL)
+                {
+                    cout << "Invalid transaction index!\n";
+                    break;
+                }
+                
+                vector<SHA256Digest> proof = targetBlock->proveTransaction(txIndex);
+                cout << "\nTransaction: ";
+                tx->display();
+                cout << "Merkle root: " << targetBlock->header.txRoot.toHex().substr(0, 32) << "...\n";
+                cout << "Proof (" << proof.size() << " hashes):\n";
+                for (size_t i = 0; i < proof.size(); i++)
+                {
+                    cout << "  " << proof[i].toHex().substr(0, 32) << "...\n";
+                }
+                
+                if (targetBlock->verifyTransaction(tx, txIndex, proof))
+                {
+                    cout << "Transaction is included in block #" << blockNum << "!\n";
+                }
+                else
+                {
+                    cout << "Inclusion proof FAILED!\n";
+                }
+                break;
+            }
+            case 15: {
+                runBenchmarks();
+                break;
+            }
+            case 16: {
+                displayNetworkUsers();
+                int idx;
+                cout << "User number: ";
+                cin >> idx;
+                cin.ignore(10000, '\n');
+                
+                User* user = networkUsers.getUserAt(idx - 1);
+                if (user != NULL && user->localBlockchain != NULL)
+                {
+                    int newLimit;
+                    cout << "Current max transactions per block: " << user->localBlockchain->maxBlockTransactions << "\n";
+                    cout << "Enter max transactions per block, including the reward (2-100000): ";
+                    cin >> newLimit;
+                    cin.ignore(10000, '\n');
+                    
+                    if (newLimit >= 2 && newLimit <= 100000)
+                    {
+                        user->localBlockchain->maxBlockTransactions = newLimit;
+                        cout << "Max transactions per block set to " << newLimit << " for " << user->name << "\n";
+                    }
+                    else
+                    {
+                        cout << "Invalid limit! Must be between 2 and 100000.\n";
+                    }
+                }
+                else
+                {
+                    cout << "Invalid user!\n";
+                }
+                break;
+            }
+            case 17: {
+                displayNetworkUsers();
+                int idx;
+                cout << "User number: ";
+                cin >> idx;
+                cin.ignore(10000, '\n');
+                
+                User* user = networkUsers.getUserAt(idx - 1);
+                if (user == NULL || user->localBlockchain == NULL)
+                {
+                    cout << "Invalid user!\n";
+                    break;
+                }
+                
+                string hex;
+                cout << "Enter block hash or transaction ID (64 hex digits): ";
+                getline(cin, hex);
+                
+                SHA256Digest digest;
+                if (!SHA256Digest::fromHex(hex, digest))
+                {
+                    cout << "Invalid hash!\n";
+                    break;
+                }
+                
+                Blockchain* chain = user->localBlockchain;
+                Block* block = chain->findBlock(digest);
+                TxLocation location;
+                if (block != NULL)
+                {
+                    cout << "Block #" << block->header.height << " with " << block->transactionCount
+                         << " transaction(s), mined " << block->timestamp << "\n";
+                }
+                else if (chain->findTransaction(digest, location))
+                {
+                    cout << "Transaction [" << location.position << "] of block #" << location.height << ": ";
+                    chain->getBlock(location.height)->getTransaction(location.position)->display();
+                }
+                else
+                {
+                    cout << "No block or transaction with that hash in " << user->name << "'s chain.\n";
+                }
+                break;
+            }
+            case 18: {
+                displayNetworkUsers();
+                int idx;
+                cout << "User number: ";
+                cin >> idx;
+                cin.ignore(10000, '\n');
+                
+                User* user = networkUsers.getUserAt(idx - 1);
+                if (user == NULL || user->localBlockchain == NULL)
+                {
+                    cout << "Invalid user!\n";
+                    break;
+                }
+                
+                string address;
+                cout << "Enter address: ";
+                getline(cin, address);
+                
+                int page;
+                cout << "Page number (10 transactions per page): ";
+                cin >> page;
+                cin.ignore(10000, '\n');
+                
+                user->localBlockchain->displayHistory(address, page < 1 ? 0 : (size_t)page, 10);
+                break;
+            }
+            case 19: {
+                int newSize;
+                cout << "Current committee size: ";
+                if (consensusCommitteeSize == 0)
+                    cout << "0 (every active user votes)\n";
+                else
+                    cout << consensusCommitteeSize << "\n";
+                cout << "Enter committee size (0 for every active user, 3-100000): ";
+                cin >> newSize;
+                cin.ignore(10000, '\n');
+                
+                if (newSize == 0 || (newSize >= 3 && newSize <= 100000))
+                {
+                    consensusCommitteeSize = newSize;
+                    cout << "Consensus committee size set to " << newSize << "\n";
+                }
+                else
+                {
+                    cout << "Invalid size! Must be 0 or between 3 and 100000.\n";
+                }
+                break;
+            }
+            case 20: {
+                displayNetworkUsers();
+                int idx;
+                cout << "User number: ";
+                cin >> idx;
+                cin.ignore(10000, '\n');
+
+                User* user = networkUsers.getUserAt(idx - 1);
+                if (user == NULL || user->localBlockchain == NULL)
+                {
+                    cout << "Invalid user!\n";
+                    break;
+                }
+
+                vector<User*> peerUsers;
+                vector<Blockchain*> peers;
+                for (User* temp = networkUsers.head; temp != NULL; temp = temp->next)
+                {
+                    if (temp != user && temp->isActive)
+                    {
+                        peerUsers.push_back(temp);
+                        peers.push_back(temp->localBlockchain);
+                    }
+                }
+
+                SyncReport report;
+                int blocksBefore = user->localBlockchain->getBlockCount();
+                bool synced = syncChain(user->localBlockchain, peers, report, user->localBlockchain->miningThreads);
+                for (size_t i = 0; i < report.badPeers.size(); i++)
+                {
+                    cout << peerUsers[report.badPeers[i]]->name << " served bad blocks and was dropped.\n";
+                }
+                if (!synced)
+                {
+                    cout << "Resync failed: no active peer could serve a valid chain.\n";
+                }
+                else if (report.blocks == 0 && user->localBlockchain->getBlockCount() == blocksBefore)
+                {
+                    cout << user->name << "'s blockchain is already up to date.\n";
+                }
+                else
+                {
+                    cout << "Downloaded " << report.blocks << " blocks from #" << report.fromHeight << " in "
+                         << report.chunks << " chunks from " << report.peers << " peers ("
+                         << report.retries << " retries) in " << report.seconds * 1e3 << " ms\n";
+                    cout << user->name << "'s blockchain now has " << user->localBlockchain->getBlockCount()
+                         << " blocks.\n";
+                }
+                break;
+            }
             case 0:
                 cout << "\n========== EXITING BLOCKCHAIN NETWORK ==========\n";
                 cout << "Thank you for using the blockchain system!\n";
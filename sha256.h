@@ -2,19 +2,712 @@
 #define SHA256_H
 
 #include <string>
-#include <sstream>
-#include <iomanip>
 #include <cstring>
+#include <cstddef>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SHA256_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SHA256_ARM 1
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#include <windows.h>
+#else
+#include <arm_neon.h>
+#endif
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA256_TARGET(x) __attribute__((target(x)))
+#else
+#define SHA256_TARGET(x)
+#endif
+
+#if defined(__clang__)
+#define SHA256_TARGET_ARM SHA256_TARGET("crypto")
+#else
+#define SHA256_TARGET_ARM SHA256_TARGET("+crypto")
+#endif
+
+static const unsigned int SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+    0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+    0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+    0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+    0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+    0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+    0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+    0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const unsigned int SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// Compresses `blocks` consecutive 64-byte blocks into `state`.
+typedef void (*SHA256CompressFunction)(unsigned int state[8], const unsigned char* data, size_t blocks);
+
+inline unsigned int sha256_rotr(unsigned int x, unsigned int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline void sha256_compress_portable(unsigned int state[8], const unsigned char* data, size_t blocks) {
+    while (blocks--) {
+        unsigned int w[64], a, b, c, d, e, f, g, h;
+
+        for (int i = 0; i < 16; i++)
+            w[i] = ((unsigned int)data[i * 4] << 24) |
+                ((unsigned int)data[i * 4 + 1] << 16) |
+                ((unsigned int)data[i * 4 + 2] << 8) |
+                ((unsigned int)data[i * 4 + 3]);
+
+        for (int i = 16; i < 64; i++)
+            w[i] = w[i - 16] + (sha256_rotr(w[i - 15], 7) ^ sha256_rotr(w[i - 15], 18) ^ (w[i - 15] >> 3))
+                + w[i - 7] + (sha256_rotr(w[i - 2], 17) ^ sha256_rotr(w[i - 2], 19) ^ (w[i - 2] >> 10));
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+        for (int i = 0; i < 64; i++) {
+            unsigned int t1 = h + (sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^ sha256_rotr(e, 25))
+                + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+            unsigned int t2 = (sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22))
+                + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e;
+            e = d + t1;
+            d = c; c = b; b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += 64;
+    }
+}
+
+#if defined(SHA256_X86)
+inline void sha256_cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = (unsigned int)r[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+inline bool sha256_cpu_has_shani() {
+    unsigned int regs[4];
+    sha256_cpuid(0, 0, regs);
+    if (regs[0] < 7) return false;
+    sha256_cpuid(1, 0, regs);
+    bool ssse3 = (regs[2] & (1u << 9)) != 0;
+    bool sse41 = (regs[2] & (1u << 19)) != 0;
+    sha256_cpuid(7, 0, regs);
+    bool sha = (regs[1] & (1u << 29)) != 0;
+    return ssse3 && sse41 && sha;
+}
+
+// Message words are kept as four 128-bit groups; the state is held in the
+// ABEF/CDGH layout that sha256rnds2 expects.
+SHA256_TARGET("sha,ssse3,sse4.1")
+inline void sha256_compress_shani(unsigned int state[8], const unsigned char* data, size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (blocks--) {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+        __m128i m[4];
+
+        for (int g = 0; g < 16; g++) {
+            __m128i w;
+            if (g < 4) {
+                w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * g)), MASK);
+            } else {
+                w = _mm_sha256msg1_epu32(m[g & 3], m[(g + 1) & 3]);
+                w = _mm_add_epi32(w, _mm_alignr_epi8(m[(g + 3) & 3], m[(g + 2) & 3], 4));
+                w = _mm_sha256msg2_epu32(w, m[(g + 3) & 3]);
+            }
+            m[g & 3] = w;
+
+            __m128i wk = _mm_add_epi32(w, _mm_loadu_si128((const __m128i*)&SHA256_K[4 * g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+#endif
+
+#if defined(SHA256_ARM)
+inline bool sha256_cpu_has_armv8_sha2() {
+#if defined(__APPLE__)
+    return true;
+#elif defined(__linux__) && defined(HWCAP_SHA2)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#elif defined(_WIN32)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+#else
+    return false;
+#endif
+}
+
+SHA256_TARGET_ARM
+inline void sha256_compress_armv8(unsigned int state[8], const unsigned char* data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    while (blocks--) {
+        uint32x4_t abcdSave = state0;
+        uint32x4_t efghSave = state1;
+        uint32x4_t m[4];
+
+        for (int i = 0; i < 4; i++)
+            m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+        for (int g = 0; g < 16; g++) {
+            if (g >= 4)
+                m[g & 3] = vsha256su1q_u32(vsha256su0q_u32(m[g & 3], m[(g + 1) & 3]),
+                    m[(g + 2) & 3], m[(g + 3) & 3]);
+
+            uint32x4_t wk = vaddq_u32(m[g & 3], vld1q_u32(&SHA256_K[4 * g]));
+            uint32x4_t tmp = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, tmp, wk);
+        }
+
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+        data += 64;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#endif
+
+// Multi-lane kernels compress one block for each of several independent
+// messages at once. State is word-major: state[word * lanes + lane].
+typedef void (*SHA256MultiCompressFunction)(unsigned int* state, const unsigned char* const* data);
+
+const size_t SHA256_MAX_LANES = 16;
+
+inline void sha256_compress_x1(unsigned int* state, const unsigned char* const* data);
+
+#if defined(SHA256_X86)
+inline unsigned long long sha256_xgetbv() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+inline bool sha256_cpu_has_avx2() {
+    unsigned int regs[4];
+    sha256_cpuid(0, 0, regs);
+    if (regs[0] < 7) return false;
+    sha256_cpuid(1, 0, regs);
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    if (!osxsave || (sha256_xgetbv() & 0x6) != 0x6) return false;
+    sha256_cpuid(7, 0, regs);
+    return (regs[1] & (1u << 5)) != 0;
+}
+
+inline bool sha256_cpu_has_avx512() {
+    if (!sha256_cpu_has_avx2() || (sha256_xgetbv() & 0xE6) != 0xE6) return false;
+    unsigned int regs[4];
+    sha256_cpuid(7, 0, regs);
+    bool f = (regs[1] & (1u << 16)) != 0;
+    bool bw = (regs[1] & (1u << 30)) != 0;
+    return f && bw;
+}
+
+SHA256_TARGET("avx2")
+inline __m256i sha256_rotr_x8(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+SHA256_TARGET("avx2")
+inline void sha256_transpose_x8(__m256i r[8]) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+SHA256_TARGET("avx2")
+inline void sha256_compress_x8_avx2(unsigned int* state, const unsigned char* const* data) {
+    const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i w[16];
+    for (int half = 0; half < 2; half++) {
+        __m256i r[8];
+        for (int l = 0; l < 8; l++)
+            r[l] = _mm256_loadu_si256((const __m256i*)(data[l] + 32 * half));
+        sha256_transpose_x8(r);
+        for (int i = 0; i < 8; i++)
+            w[8 * half + i] = _mm256_shuffle_epi8(r[i], bswap);
+    }
+
+    __m256i s[8];
+    for (int i = 0; i < 8; i++)
+        s[i] = _mm256_loadu_si256((const __m256i*)(state + 8 * i));
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16) {
+            __m256i w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_x8(w15, 7), sha256_rotr_x8(w15, 18)),
+                                          _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_x8(w2, 17), sha256_rotr_x8(w2, 19)),
+                                          _mm256_srli_epi32(w2, 10));
+            w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0),
+                                         _mm256_add_epi32(w[(i - 7) & 15], s1));
+        }
+
+        __m256i bigS1 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_x8(e, 6), sha256_rotr_x8(e, 11)),
+                                         sha256_rotr_x8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, bigS1),
+                                      _mm256_add_epi32(ch, _mm256_add_epi32(_mm256_set1_epi32((int)SHA256_K[i]), w[i & 15])));
+        __m256i bigS0 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotr_x8(a, 2), sha256_rotr_x8(a, 13)),
+                                         sha256_rotr_x8(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(bigS0, maj);
+        h = g; g = f; f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+    for (int i = 0; i < 8; i++)
+        _mm256_storeu_si256((__m256i*)(state + 8 * i), s[i]);
+}
+
+// GCC 12 warns about the undefined passthrough operand inside its own
+// AVX-512 intrinsic wrappers when they are used under a target attribute.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// 16x16 transpose as four butterfly stages: at distance d, rows i and i + d
+// swap their off-diagonal d-wide column groups.
+SHA256_TARGET("avx512f")
+inline void sha256_transpose_x16(__m512i r[16]) {
+    for (int d = 8; d >= 1; d /= 2) {
+        int lo[16], hi[16];
+        for (int j = 0; j < 16; j++) {
+            int base = j / (2 * d) * (2 * d), o = j % (2 * d);
+            lo[j] = o < d ? base + o : 16 + base + o - d;
+            hi[j] = o < d ? base + d + o : 16 + base + o;
+        }
+        __m512i loIdx = _mm512_loadu_si512(lo), hiIdx = _mm512_loadu_si512(hi);
+        for (int i = 0; i < 16; i++) {
+            if (i & d) continue;
+            __m512i x = r[i], y = r[i + d];
+            r[i] = _mm512_permutex2var_epi32(x, loIdx, y);
+            r[i + d] = _mm512_permutex2var_epi32(x, hiIdx, y);
+        }
+    }
+}
+
+SHA256_TARGET("avx512f,avx512bw")
+inline void sha256_compress_x16_avx512(unsigned int* state, const unsigned char* const* data) {
+    const __m512i bswap = _mm512_set4_epi32(0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203);
+    __m512i w[16];
+    for (int l = 0; l < 16; l++)
+        w[l] = _mm512_loadu_si512(data[l]);
+    sha256_transpose_x16(w);
+    for (int i = 0; i < 16; i++)
+        w[i] = _mm512_shuffle_epi8(w[i], bswap);
+
+    __m512i s[8];
+    for (int i = 0; i < 8; i++)
+        s[i] = _mm512_loadu_si512(state + 16 * i);
+    __m512i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16) {
+            __m512i w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+            __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18),
+                                                   _mm512_srli_epi32(w15, 3), 0x96);
+            __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19),
+                                                   _mm512_srli_epi32(w2, 10), 0x96);
+            w[i & 15] = _mm512_add_epi32(_mm512_add_epi32(w[i & 15], s0),
+                                         _mm512_add_epi32(w[(i - 7) & 15], s1));
+        }
+
+        __m512i bigS1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11),
+                                                  _mm512_ror_epi32(e, 25), 0x96);
+        __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+        __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, bigS1),
+                                      _mm512_add_epi32(ch, _mm512_add_epi32(_mm512_set1_epi32((int)SHA256_K[i]), w[i & 15])));
+        __m512i bigS0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13),
+                                                  _mm512_ror_epi32(a, 22), 0x96);
+        __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+        __m512i t2 = _mm512_add_epi32(bigS0, maj);
+        h = g; g = f; f = e;
+        e = _mm512_add_epi32(d, t1);
+        d = c; c = b; b = a;
+        a = _mm512_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm512_add_epi32(s[0], a); s[1] = _mm512_add_epi32(s[1], b);
+    s[2] = _mm512_add_epi32(s[2], c); s[3] = _mm512_add_epi32(s[3], d);
+    s[4] = _mm512_add_epi32(s[4], e); s[5] = _mm512_add_epi32(s[5], f);
+    s[6] = _mm512_add_epi32(s[6], g); s[7] = _mm512_add_epi32(s[7], h);
+    for (int i = 0; i < 8; i++)
+        _mm512_storeu_si512(state + 16 * i, s[i]);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+struct SHA256Backend {
+    const char* name;
+    SHA256CompressFunction compress;
+};
+
+// Every backend the running CPU supports, fastest first. The portable
+// backend is always last so there is a fallback.
+inline int sha256_available_backends(SHA256Backend out[4]) {
+    int count = 0;
+#if defined(SHA256_X86)
+    if (sha256_cpu_has_shani()) {
+        out[count].name = "x86 SHA-NI";
+        out[count].compress = sha256_compress_shani;
+        count++;
+    }
+#endif
+#if defined(SHA256_ARM)
+    if (sha256_cpu_has_armv8_sha2()) {
+        out[count].name = "ARMv8 SHA2";
+        out[count].compress = sha256_compress_armv8;
+        count++;
+    }
+#endif
+    out[count].name = "Portable";
+    out[count].compress = sha256_compress_portable;
+    count++;
+    return count;
+}
+
+inline bool sha256_backend_passes_vectors(const SHA256Backend& backend);
+
+// Picked once, on first use: the fastest backend that also reproduces the
+// known-answer vectors.
+inline const SHA256Backend& sha256_active_backend() {
+    static const SHA256Backend active = []() -> SHA256Backend {
+        SHA256Backend backends[4];
+        int count = sha256_available_backends(backends);
+        for (int i = 0; i < count - 1; i++) {
+            if (sha256_backend_passes_vectors(backends[i]))
+                return backends[i];
+        }
+        return backends[count - 1];
+    }();
+    return active;
+}
+
+inline std::string sha256_to_hex(const unsigned char digest[32]) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(64, '0');
+    for (int i = 0; i < 32; i++) {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0x0f];
+    }
+    return hex;
+}
+
+inline int sha256_leading_zero_bits(const unsigned char digest[32]) {
+    int bits = 0;
+    for (int i = 0; i < 32; i++) {
+        if (digest[i] == 0) {
+            bits += 8;
+            continue;
+        }
+        unsigned char byte = digest[i];
+        while ((byte & 0x80) == 0) {
+            bits++;
+            byte <<= 1;
+        }
+        break;
+    }
+    return bits;
+}
+
+// A digest kept in its binary form. Hex is only produced for display.
+// It is a plain aggregate so it can sit inside fixed-layout structs that
+// are hashed straight from memory; SHA256Digest() is the all-zero digest.
+struct SHA256Digest {
+    unsigned char bytes[32];
+
+    static SHA256Digest fromBytes(const unsigned char digest[32]) {
+        SHA256Digest result;
+        memcpy(result.bytes, digest, sizeof(result.bytes));
+        return result;
+    }
+
+    bool operator==(const SHA256Digest& other) const { return memcmp(bytes, other.bytes, 32) == 0; }
+    bool operator!=(const SHA256Digest& other) const { return !(*this == other); }
+
+    bool isZero() const {
+        for (int i = 0; i < 32; i++)
+            if (bytes[i] != 0) return false;
+        return true;
+    }
+
+    int leadingZeroBits() const { return sha256_leading_zero_bits(bytes); }
+    std::string toHex() const { return sha256_to_hex(bytes); }
+
+    // Parses exactly 64 hex digits, either case.
+    static bool fromHex(const std::string& hex, SHA256Digest& digest) {
+        if (hex.size() != 64) return false;
+        for (int i = 0; i < 64; i++) {
+            char c = hex[i];
+            int value;
+            if (c >= '0' && c <= '9') value = c - '0';
+            else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+            else return false;
+            if (i % 2 == 0) digest.bytes[i / 2] = (unsigned char)(value << 4);
+            else digest.bytes[i / 2] |= (unsigned char)value;
+        }
+        return true;
+    }
+};
+
+static_assert(sizeof(SHA256Digest) == 32, "SHA256Digest must be exactly the digest bytes");
+
+struct SHA256MultiBackend {
+    const char* name;
+    size_t lanes;
+    SHA256MultiCompressFunction compress;
+};
+
+// One lane is the active single-stream backend, which is what SHA-NI and
+// ARMv8 machines without wide vectors end up using.
+inline void sha256_compress_x1(unsigned int* state, const unsigned char* const* data) {
+    sha256_active_backend().compress(state, data[0], 1);
+}
+
+inline int sha256_available_multi_backends(SHA256MultiBackend out[3]) {
+    int count = 0;
+#if defined(SHA256_X86)
+    if (sha256_cpu_has_avx512()) {
+        out[count].name = "AVX-512 x16";
+        out[count].lanes = 16;
+        out[count].compress = sha256_compress_x16_avx512;
+        count++;
+    }
+    if (sha256_cpu_has_avx2()) {
+        out[count].name = "AVX2 x8";
+        out[count].lanes = 8;
+        out[count].compress = sha256_compress_x8_avx2;
+        count++;
+    }
+#endif
+    out[count].name = "Single lane";
+    out[count].lanes = 1;
+    out[count].compress = sha256_compress_x1;
+    count++;
+    return count;
+}
+
+// Finishes count messages that all continue from the same midstate: each
+// lane hashes prefix || messages[i] starting from `initial`, where
+// bytesBefore bytes have already been compressed into `initial`. Messages
+// may have different lengths; a lane whose message has run out of blocks
+// keeps compressing a dummy block and its result is simply ignored.
+inline void sha256_many_from(const SHA256MultiBackend& backend, const unsigned int initial[8],
+                             const unsigned char* prefix, size_t prefixLength,
+                             unsigned long long bytesBefore, const unsigned char* const* messages,
+                             const size_t* lengths, size_t count, unsigned char (*digests)[32]) {
+    const size_t lanes = backend.lanes;
+    unsigned int state[8 * SHA256_MAX_LANES];
+    // Zeroed so that spare lanes never compress uninitialized bytes.
+    unsigned char scratch[SHA256_MAX_LANES][64] = {};
+    const unsigned char* blocks[SHA256_MAX_LANES];
+    size_t totalBlocks[SHA256_MAX_LANES];
+
+    for (size_t base = 0; base < count; base += lanes) {
+        size_t used = count - base < lanes ? count - base : lanes;
+        size_t maxBlocks = 0;
+
+        for (size_t l = 0; l < lanes; l++) {
+            for (int i = 0; i < 8; i++)
+                state[i * lanes + l] = initial[i];
+            totalBlocks[l] = l < used ? (prefixLength + lengths[base + l] + 9 + 63) / 64 : 0;
+            if (totalBlocks[l] > maxBlocks) maxBlocks = totalBlocks[l];
+        }
+
+        for (size_t b = 0; b < maxBlocks; b++) {
+            for (size_t l = 0; l < lanes; l++) {
+                if (b >= totalBlocks[l]) {
+                    blocks[l] = scratch[l];
+                    continue;
+                }
+
+                const unsigned char* message = messages[base + l];
+                size_t dataLength = prefixLength + lengths[base + l];
+                size_t start = b * 64;
+                if (start >= prefixLength && start + 64 <= dataLength) {
+                    blocks[l] = message + (start - prefixLength);
+                    continue;
+                }
+
+                unsigned char* out = scratch[l];
+                memset(out, 0, 64);
+                if (start < prefixLength)
+                    memcpy(out, prefix + start, prefixLength - start < 64 ? prefixLength - start : 64);
+                size_t from = start > prefixLength ? start : prefixLength;
+                size_t to = start + 64 < dataLength ? start + 64 : dataLength;
+                if (from < to)
+                    memcpy(out + (from - start), message + (from - prefixLength), to - from);
+                if (dataLength >= start && dataLength < start + 64)
+                    out[dataLength - start] = 0x80;
+                if (b + 1 == totalBlocks[l]) {
+                    unsigned long long bits = (bytesBefore + dataLength) * 8;
+                    for (int i = 0; i < 8; i++)
+                        out[63 - i] = (unsigned char)(bits >> (8 * i));
+                }
+                blocks[l] = out;
+            }
+
+            backend.compress(state, blocks);
+
+            for (size_t l = 0; l < used; l++) {
+                if (b + 1 != totalBlocks[l]) continue;
+                for (int i = 0; i < 8; i++) {
+                    unsigned int word = state[i * lanes + l];
+                    digests[base + l][4 * i] = (unsigned char)(word >> 24);
+                    digests[base + l][4 * i + 1] = (unsigned char)(word >> 16);
+                    digests[base + l][4 * i + 2] = (unsigned char)(word >> 8);
+                    digests[base + l][4 * i + 3] = (unsigned char)word;
+                }
+            }
+        }
+    }
+}
+
+// Hashes count independent messages with the given multi-lane backend.
+inline void sha256_many(const SHA256MultiBackend& backend, const unsigned char* const* messages,
+                        const size_t* lengths, size_t count, unsigned char (*digests)[32]) {
+    sha256_many_from(backend, SHA256_IV, NULL, 0, 0, messages, lengths, count, digests);
+}
+
+inline bool sha256_multi_backend_passes_vectors(const SHA256MultiBackend& backend);
+
+// The widest multi-lane backend that reproduces the known-answer vectors.
+inline const SHA256MultiBackend& sha256_active_multi_backend() {
+    static const SHA256MultiBackend active = []() -> SHA256MultiBackend {
+        SHA256MultiBackend backends[3];
+        int count = sha256_available_multi_backends(backends);
+        for (int i = 0; i < count - 1; i++) {
+            if (sha256_multi_backend_passes_vectors(backends[i]))
+                return backends[i];
+        }
+        return backends[count - 1];
+    }();
+    return active;
+}
+
+// Number of messages sha256_many() hashes per kernel call. Callers that
+// generate candidates (nonces, block headers) should batch in multiples of it.
+inline size_t sha256_batch_lanes() {
+    return sha256_active_multi_backend().lanes;
+}
 
 class SHA256 {
 public:
     unsigned int DIGEST_SIZE;
-    SHA256() { DIGEST_SIZE = 32; reset(); }
+    SHA256() { DIGEST_SIZE = 32; compress = sha256_active_backend().compress; reset(); }
+    explicit SHA256(const SHA256Backend& backend) { DIGEST_SIZE = 32; compress = backend.compress; reset(); }
 
     void update(const unsigned char* data, size_t len) {
-        for(size_t i = 0; i < len; i++) {
-            dataBuffer[dataLength] = data[i];
-            dataLength++;
+        while (len > 0) {
+            if (dataLength == 0 && len >= 64) {
+                size_t blocks = len / 64;
+                compress(state, data, blocks);
+                totalLength += blocks * 512;
+                data += blocks * 64;
+                len -= blocks * 64;
+                continue;
+            }
+
+            size_t take = 64 - dataLength;
+            if (take > len) take = len;
+            memcpy(dataBuffer + dataLength, data, take);
+            dataLength += (unsigned int)take;
+            data += take;
+            len -= take;
+
             if (dataLength == 64) {
                 transform();
                 totalLength += 512;
@@ -27,7 +720,45 @@ public:
         update(reinterpret_cast<const unsigned char*>(data.c_str()), data.size());
     }
 
+    // Raw 32-byte digest; no allocation.
+    void final(unsigned char digest[32]) {
+        finish();
+        for (int i = 0; i < 8; i++) {
+            digest[4 * i] = (unsigned char)(state[i] >> 24);
+            digest[4 * i + 1] = (unsigned char)(state[i] >> 16);
+            digest[4 * i + 2] = (unsigned char)(state[i] >> 8);
+            digest[4 * i + 3] = (unsigned char)state[i];
+        }
+        reset();
+    }
+
+    SHA256Digest finalDigest() {
+        SHA256Digest digest = SHA256Digest();
+        final(digest.bytes);
+        return digest;
+    }
+
     std::string final() {
+        return finalDigest().toHex();
+    }
+
+    // Treats this object as a midstate and finishes count copies of it, each
+    // extended with its own tail, in multi-lane batches. The object itself is
+    // left unchanged, so it can be reused for the next batch.
+    void finalMany(const unsigned char* const* tails, const size_t* lengths, size_t count,
+                   unsigned char (*digests)[32]) const {
+        sha256_many_from(sha256_active_multi_backend(), state, dataBuffer, dataLength,
+                         totalLength / 8, tails, lengths, count, digests);
+    }
+
+private:
+    unsigned char dataBuffer[64];
+    unsigned int dataLength;
+    unsigned long long totalLength;
+    unsigned int state[8];
+    SHA256CompressFunction compress;
+
+    void finish() {
         unsigned int i = dataLength;
 
         if (dataLength < 56) {
@@ -50,90 +781,131 @@ public:
         dataBuffer[57] = totalLength >> 48;
         dataBuffer[56] = totalLength >> 56;
         transform();
-
-        std::ostringstream result;
-        for (int i = 0; i < 8; i++)
-            result << std::hex << std::setw(8) << std::setfill('0') << state[i];
-
-        reset();
-        return result.str();
     }
 
-private:
-    unsigned char dataBuffer[64];
-    unsigned int dataLength;
-    unsigned long long totalLength;
-    unsigned int state[8];
-
     void reset() {
         dataLength = 0;
         totalLength = 0;
-        state[0] = 0x6a09e667;
-        state[1] = 0xbb67ae85;
-        state[2] = 0x3c6ef372;
-        state[3] = 0xa54ff53a;
-        state[4] = 0x510e527f;
-        state[5] = 0x9b05688c;
-        state[6] = 0x1f83d9ab;
-        state[7] = 0x5be0cd19;
+        for (int i = 0; i < 8; i++)
+            state[i] = SHA256_IV[i];
     }
 
-    unsigned int rotr(unsigned int x, unsigned int n) {
-        return (x >> n) | (x << (32 - n));
+    void transform() {
+        compress(state, dataBuffer, 1);
     }
+};
 
-    void transform() {
-        unsigned int K[64] = {
-            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
-            0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
-            0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
-            0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-            0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
-            0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
-            0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
-            0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
-            0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
-            0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
-            0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-            0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-        };
+inline std::string sha256(const std::string &data) {
+    SHA256 sha;
+    sha.update(data);
+    return sha.final();
+}
 
-        unsigned int w[64], a, b, c, d, e, f, g, h;
+inline SHA256Digest sha256_digest(const unsigned char* data, size_t len) {
+    SHA256 sha;
+    sha.update(data, len);
+    return sha.finalDigest();
+}
 
-        for (int i = 0; i < 16; i++)
-            w[i] = (dataBuffer[i * 4] << 24) |
-                (dataBuffer[i * 4 + 1] << 16) |
-                (dataBuffer[i * 4 + 2] << 8) |
-                (dataBuffer[i * 4 + 3]);
+inline SHA256Digest sha256_digest(const std::string& data) {
+    return sha256_digest(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+}
 
-        for (int i = 16; i < 64; i++)
-            w[i] = w[i - 16] + (rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3))
-                + w[i - 7] + (rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10));
+inline void sha256_many(const unsigned char* const* messages, const size_t* lengths,
+                        size_t count, unsigned char (*digests)[32]) {
+    sha256_many(sha256_active_multi_backend(), messages, lengths, count, digests);
+}
 
-        a = state[0]; b = state[1]; c = state[2]; d = state[3];
-        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+inline std::vector<SHA256Digest> sha256_many(const std::vector<std::string>& messages) {
+    size_t count = messages.size();
+    std::vector<const unsigned char*> pointers(count);
+    std::vector<size_t> lengths(count);
+    std::vector<SHA256Digest> digests(count);
+    for (size_t i = 0; i < count; i++) {
+        pointers[i] = reinterpret_cast<const unsigned char*>(messages[i].data());
+        lengths[i] = messages[i].size();
+    }
 
-        for (int i = 0; i < 64; i++) {
-            unsigned int t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25))
-                + ((e & f) ^ (~e & g)) + K[i] + w[i];
-            unsigned int t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22))
-                + ((a & b) ^ (a & c) ^ (b & c));
-            h = g; g = f; f = e;
-            e = d + t1;
-            d = c; c = b; b = a;
-            a = t1 + t2;
-        }
+    if (count > 0)
+        sha256_many(&pointers[0], &lengths[0], count, reinterpret_cast<unsigned char (*)[32]>(&digests[0]));
+    return digests;
+}
 
-        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
-        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
-    }
+struct SHA256TestVector {
+    const char* message;
+    size_t repeat;
+    const char* digest;
 };
 
-inline std::string sha256(const std::string &data) {
-    SHA256 sha;
-    sha.update(data);
-    return sha.final();
+// FIPS 180-2 / NIST CAVP vectors. Lengths are chosen to cover the one- and
+// two-block padding cases and the multi-block fast path in update().
+static const SHA256TestVector SHA256_TEST_VECTORS[] = {
+    { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+      "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+    { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" }
+};
+
+inline bool sha256_backend_passes_vectors(const SHA256Backend& backend) {
+    size_t count = sizeof(SHA256_TEST_VECTORS) / sizeof(SHA256_TEST_VECTORS[0]);
+    for (size_t v = 0; v < count; v++) {
+        const SHA256TestVector& vector = SHA256_TEST_VECTORS[v];
+        std::string message;
+        for (size_t r = 0; r < vector.repeat; r++)
+            message += vector.message;
+
+        SHA256 sha(backend);
+        sha.update(message);
+        if (sha.final() != vector.digest)
+            return false;
+    }
+    return true;
+}
+
+// All vectors go through one sha256_many() call so lanes of different
+// lengths finish at different blocks, as they do in real batches.
+inline bool sha256_multi_backend_passes_vectors(const SHA256MultiBackend& backend) {
+    const size_t count = sizeof(SHA256_TEST_VECTORS) / sizeof(SHA256_TEST_VECTORS[0]);
+    std::string messages[count];
+    const unsigned char* pointers[count];
+    size_t lengths[count];
+    unsigned char digests[count][32];
+
+    for (size_t v = 0; v < count; v++) {
+        for (size_t r = 0; r < SHA256_TEST_VECTORS[v].repeat; r++)
+            messages[v] += SHA256_TEST_VECTORS[v].message;
+        pointers[v] = reinterpret_cast<const unsigned char*>(messages[v].data());
+        lengths[v] = messages[v].size();
+    }
+
+    sha256_many(backend, pointers, lengths, count, digests);
+    for (size_t v = 0; v < count; v++) {
+        if (sha256_to_hex(digests[v]) != SHA256_TEST_VECTORS[v].digest)
+            return false;
+    }
+    return true;
+}
+
+// Runs the known-answer vectors through every single-stream and multi-lane
+// backend this CPU supports.
+inline bool sha256_self_test() {
+    SHA256Backend backends[4];
+    int count = sha256_available_backends(backends);
+    for (int i = 0; i < count; i++) {
+        if (!sha256_backend_passes_vectors(backends[i]))
+            return false;
+    }
+
+    SHA256MultiBackend multiBackends[3];
+    int multiCount = sha256_available_multi_backends(multiBackends);
+    for (int i = 0; i < multiCount; i++) {
+        if (!sha256_multi_backend_passes_vectors(multiBackends[i]))
+            return false;
+    }
+    return true;
 }
 
 #endif